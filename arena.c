@@ -0,0 +1,304 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+// bytes of the block header, the data starts aligned
+#define ARENA_HEADER ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/* ____________________________________________________________________________
+
+    static arena_block *block_create(size_t size)
+
+    Allocates a block of data
+
+    Parameters:
+        size - The bytes of data
+
+    Returns:
+        A pointer to the empty block or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+static arena_block *block_create(size_t size) {
+
+    if(size > (size_t)-1 - ARENA_HEADER) return NULL;
+
+    arena_block *b = (arena_block *)malloc(ARENA_HEADER + size);
+    if(!b) return NULL;
+
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+
+    return b;
+}
+
+/* ____________________________________________________________________________
+
+    arena *arena_create(size_t block_size)
+
+    Creates an empty arena, the first block is allocated by the first
+    allocation
+
+    Parameters:
+        block_size - The smallest size of a block or 0 for ARENA_BLOCK_SIZE
+
+    Returns:
+        A pointer to the arena or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+arena *arena_create(size_t block_size) {
+
+    arena *a = (arena *)malloc(sizeof(arena));
+    if(!a) return NULL;
+
+    a->blocks = NULL;
+    a->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    a->used = 0;
+    a->peak = 0;
+
+    return a;
+}
+
+/* ____________________________________________________________________________
+
+    void *arena_alloc(arena *a, size_t size)
+
+    Allocates memory aligned to ARENA_ALIGN bytes, a request larger than
+    the rest of the current block starts a new block
+
+    Parameters:
+        a - A pointer to the arena or NULL to allocate from the heap
+        size - The number of bytes
+
+    Returns:
+        A pointer to the memory or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+void *arena_alloc(arena *a, size_t size) {
+
+    if(!a) return malloc(size ? size : 1);
+
+    // every allocation keeps the next one aligned
+    if(size > (size_t)-1 - ARENA_ALIGN) return NULL;
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if(size == 0) size = ARENA_ALIGN;
+
+    arena_block *b = a->blocks;
+    if(!b || b->size - b->used < size) {
+        b = block_create(size > a->block_size ? size : a->block_size);
+        if(!b) return NULL;
+        b->next = a->blocks;
+        a->blocks = b;
+    }
+
+    void *p = (char *)b + ARENA_HEADER + b->used;
+    b->used += size;
+    a->used += size;
+    if(a->used > a->peak) a->peak = a->used;
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    void *arena_calloc(arena *a, size_t count, size_t size)
+
+    Allocates zeroed memory for an array
+
+    Parameters:
+        a - A pointer to the arena or NULL to allocate from the heap
+        count - The number of elements
+        size - The bytes of an element
+
+    Returns:
+        A pointer to the memory or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+void *arena_calloc(arena *a, size_t count, size_t size) {
+
+    if(!a) return calloc(count ? count : 1, size ? size : 1);
+    if(size && count > (size_t)-1 / size) return NULL;
+
+    void *p = arena_alloc(a, count * size);
+    if(p) memset(p, 0, count * size);
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    void *arena_grow(arena *a, void *p, size_t size, size_t new_size)
+
+    Enlarges memory of arena_alloc keeping its content like realloc. The
+    last allocation of the current block grows in place when the block
+    has room, otherwise the content moves to a new allocation and the old
+    memory stays in the arena until it is reset.
+
+    Parameters:
+        a - A pointer to the arena or NULL for memory of the heap
+        p - The memory or NULL
+        size - The bytes of the memory
+        new_size - The bytes after growing
+
+    Returns:
+        A pointer to the grown memory or NULL if memory allocation fails,
+        the memory is unchanged then
+   ____________________________________________________________________________
+*/
+void *arena_grow(arena *a, void *p, size_t size, size_t new_size) {
+
+    if(!a) return realloc(p, new_size ? new_size : 1);
+    if(!p) return arena_alloc(a, new_size);
+    if(new_size <= size) return p;
+    if(new_size > (size_t)-1 - ARENA_ALIGN) return NULL;
+
+    // the aligned sizes the allocations have taken from the block
+    size_t taken = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    size_t aligned = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    arena_block *b = a->blocks;
+    char *end = (char *)b + ARENA_HEADER + b->used;
+    if((char *)p + taken == end && b->size - b->used >= aligned - taken) {
+        b->used += aligned - taken;
+        a->used += aligned - taken;
+        if(a->used > a->peak) a->peak = a->used;
+        return p;
+    }
+
+    void *grown = arena_alloc(a, new_size);
+    if(grown) memcpy(grown, p, size);
+
+    return grown;
+}
+
+/* ____________________________________________________________________________
+
+    char *arena_strdup(arena *a, const char *s)
+
+    Creates a duplicate of a string
+
+    Parameters:
+        a - A pointer to the arena or NULL to allocate from the heap
+        s - The string
+
+    Returns:
+        A pointer to the copy or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+char *arena_strdup(arena *a, const char *s) {
+
+    // sanity check
+    if(!s) return NULL;
+
+    size_t length = strlen(s) + 1;
+    char *copy = (char *)arena_alloc(a, length);
+    if(copy) memcpy(copy, s, length);
+
+    return copy;
+}
+
+/* ____________________________________________________________________________
+
+    void arena_release(arena *a, void *p)
+
+    Releases memory of arena_alloc, memory of an arena stays until the
+    arena is reset
+
+    Parameters:
+        a - A pointer to the arena the memory came from or NULL
+        p - The memory
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void arena_release(arena *a, void *p) {
+
+    if(!a) free(p);
+}
+
+/* ____________________________________________________________________________
+
+    void arena_reset(arena *a)
+
+    Releases all allocations of the arena at once. The blocks are merged
+    into a single block of their capacity, so the arena settles on one
+    block large enough for the renders it serves.
+
+    Parameters:
+        a - A pointer to the arena
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void arena_reset(arena *a) {
+
+    // sanity check
+    if(!a) return;
+
+    a->used = 0;
+    if(!a->blocks) return;
+
+    if(a->blocks->next) {
+        size_t capacity = 0;
+        while(a->blocks) {
+            arena_block *next = a->blocks->next;
+            capacity += a->blocks->size;
+            free(a->blocks);
+            a->blocks = next;
+        }
+
+        // without memory for the merged block the next allocation retries
+        a->blocks = block_create(capacity);
+        return;
+    }
+
+    a->blocks->used = 0;
+}
+
+/* ____________________________________________________________________________
+
+    size_t arena_peak(const arena *a)
+
+    Returns the largest number of bytes the arena has held between two
+    resets
+
+    Parameters:
+        a - A pointer to the arena
+
+    Returns:
+        The peak bytes or 0 for NULL
+   ____________________________________________________________________________
+*/
+size_t arena_peak(const arena *a) {
+
+    return a ? a->peak : 0;
+}
+
+/* ____________________________________________________________________________
+
+    void arena_free(arena **a)
+
+    Frees the arena and all its blocks
+
+    Parameters:
+        a - A double pointer to the arena to be freed
+
+    Returns:
+        Nothing. The arena pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void arena_free(arena **a) {
+
+    // sanity check
+    if(!a || !*a) return;
+
+    while((*a)->blocks) {
+        arena_block *next = (*a)->blocks->next;
+        free((*a)->blocks);
+        (*a)->blocks = next;
+    }
+    free(*a);
+    *a = NULL;
+}
@@ -0,0 +1,63 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// constants
+#define ARENA_ALIGN 16              // alignment of every allocation
+#define ARENA_BLOCK_SIZE 65536      // default bytes of a block
+
+/* ____________________________________________________________________________
+
+    Arena Allocation
+
+    A region of memory for the scratch data of one render. Allocations
+    take the next bytes of the current block and are never freed one by
+    one, the whole region is released at once by arena_reset. A reset
+    arena keeps its memory, several blocks are merged into one block of
+    their capacity, so the following renders allocate without malloc.
+
+    Functions taking an arena allocate from the heap when it is NULL, the
+    memory is then returned by arena_release. An arena is not thread-safe,
+    every thread renders with its own arena.
+   ____________________________________________________________________________
+*/
+
+typedef struct arena_block {
+    struct arena_block *next;   // the previous block
+    size_t size;                // bytes of data following the header
+    size_t used;                // bytes handed out
+} arena_block;
+
+typedef struct {
+    arena_block *blocks;        // the current block first
+    size_t block_size;          // the smallest size of a new block
+    size_t used;                // bytes handed out since the last reset
+    size_t peak;                // the largest used of all renders
+} arena;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+arena *arena_create(size_t block_size);
+
+void *arena_alloc(arena *a, size_t size);
+
+void *arena_calloc(arena *a, size_t count, size_t size);
+
+void *arena_grow(arena *a, void *p, size_t size, size_t new_size);
+
+char *arena_strdup(arena *a, const char *s);
+
+void arena_release(arena *a, void *p);
+
+void arena_reset(arena *a);
+
+size_t arena_peak(const arena *a);
+
+void arena_free(arena **a);
+
+#endif //ARENA_H
@@ -0,0 +1,608 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "expression.h"
+#include "shuntingyard.h"
+#include "postfixmath.h"
+#include "optimize.h"
+#include "postscript.h"
+#include "vecmath.h"
+#include "jit.h"
+
+#ifdef __linux__
+#define BENCH_PERF 1
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// constants
+#define BENCH_WARMUP 3
+#define BENCH_REPETITIONS 15
+#define BENCH_SAMPLES 100000
+#define BENCH_PARSES 2000
+#define BENCH_WRITER_PAGES 50
+#define BENCH_X_MIN -10.0
+#define BENCH_X_MAX 10.0
+#define BENCH_SCRATCH "bench.ps"
+#define BENCH_FORMAT_VERSION 1
+
+// representative expressions, in the syntax of the command line
+static const char *corpus[] = {
+    "sin(x^2)*cos(x)",
+    "1/x",
+    "tan(x)",
+    "x^3-2*x",
+    "ln(x)",
+    "sqrt(abs(x))*exp(x/10)",
+    "sin(x)+sin(2*x)/2+sin(3*x)/3+sin(4*x)/4",
+    "(x^2+1)/(x^4+2)",
+    "atan(x)*cosh(x/8)+log(abs(x)+1)",
+    "x^x",
+    NULL
+};
+
+// options of the benchmark
+typedef struct {
+    int warmup;
+    int repetitions;
+    int perf;
+    const char *scratch;
+} bench_options;
+
+// hardware counters of the measured repetitions
+typedef struct {
+    int leader;
+    int instructions;
+    uint64_t cycles_total;
+    uint64_t instructions_total;
+    int valid;
+} counters;
+
+// a measured operation, run once per repetition
+typedef struct {
+    const char *name;
+    const char *expression;
+    const char *unit;
+    double units;       // operations done by one run
+    int rate;           // report units per second instead of ns per unit
+    void (*run)(void *context);
+    void *context;
+} benchmark;
+
+/* ____________________________________________________________________________
+
+    static double now_ns(void)
+
+    Returns the monotonic time in nanoseconds
+
+    Parameters:
+        None
+
+    Returns:
+        The current time
+   ____________________________________________________________________________
+*/
+static double now_ns(void) {
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (double)t.tv_sec * 1e9 + (double)t.tv_nsec;
+}
+
+#ifdef BENCH_PERF
+
+/* ____________________________________________________________________________
+
+    static int perf_open(uint64_t config, int group)
+
+    Opens a hardware counter of the calling thread, user space only
+
+    Parameters:
+        config - The counted hardware event
+        group - The leader of the group or -1 for a new, disabled leader
+
+    Returns:
+        The file descriptor of the counter or -1
+   ____________________________________________________________________________
+*/
+static int perf_open(uint64_t config, int group) {
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = group < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+#endif
+
+/* ____________________________________________________________________________
+
+    static void counters_open(counters *c, int enabled)
+
+    Opens the cycle and instruction counters of the calling thread by
+    perf_event_open, the counters stay invalid if they are not available
+
+    Parameters:
+        c - A pointer to the counters
+        enabled - 0 to skip the counters
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void counters_open(counters *c, int enabled) {
+
+    c->leader = -1;
+    c->instructions = -1;
+    c->valid = 0;
+
+#ifdef BENCH_PERF
+    if(!enabled) return;
+
+    c->leader = perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if(c->leader < 0) return;
+    c->instructions = perf_open(PERF_COUNT_HW_INSTRUCTIONS, c->leader);
+    if(c->instructions < 0) {
+        close(c->leader);
+        c->leader = -1;
+        return;
+    }
+    c->valid = 1;
+#else
+    (void)enabled;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    static void counters_start(counters *c)
+
+    Resets and enables the counters before the measured repetitions
+
+    Parameters:
+        c - A pointer to the counters
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void counters_start(counters *c) {
+
+    c->cycles_total = 0;
+    c->instructions_total = 0;
+
+#ifdef BENCH_PERF
+    if(!c->valid) return;
+    ioctl(c->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(c->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    static void counters_stop(counters *c)
+
+    Disables the counters and reads the totals of the repetitions
+
+    Parameters:
+        c - A pointer to the counters
+
+    Returns:
+        Nothing. The counters become invalid if they cannot be read
+   ____________________________________________________________________________
+*/
+static void counters_stop(counters *c) {
+
+#ifdef BENCH_PERF
+    if(!c->valid) return;
+    ioctl(c->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    // number of events followed by their values
+    uint64_t values[3];
+    if(read(c->leader, values, sizeof(values)) == (ssize_t)sizeof(values) && values[0] == 2) {
+        c->cycles_total = values[1];
+        c->instructions_total = values[2];
+    } else {
+        c->valid = 0;
+    }
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    static void counters_close(counters *c)
+
+    Closes the counters
+
+    Parameters:
+        c - A pointer to the counters
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void counters_close(counters *c) {
+
+#ifdef BENCH_PERF
+    if(c->instructions >= 0) close(c->instructions);
+    if(c->leader >= 0) close(c->leader);
+#endif
+    c->leader = -1;
+    c->instructions = -1;
+}
+
+/* ____________________________________________________________________________
+
+    static int compare_doubles(const void *a, const void *b)
+
+    Orders doubles ascending for qsort
+
+    Parameters:
+        a - A pointer to the first value
+        b - A pointer to the second value
+
+    Returns:
+        A negative, zero or positive number
+   ____________________________________________________________________________
+*/
+static int compare_doubles(const void *a, const void *b) {
+
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* ____________________________________________________________________________
+
+    static double percentile(const double *sorted, int n, double p)
+
+    Returns a percentile of sorted values by the nearest rank
+
+    Parameters:
+        sorted - The values in ascending order
+        n - The number of values
+        p - The percentile between 0 and 100
+
+    Returns:
+        The value of the percentile
+   ____________________________________________________________________________
+*/
+static double percentile(const double *sorted, int n, double p) {
+
+    int rank = (int)(p / 100.0 * n + 0.999999);
+    if(rank < 1) rank = 1;
+    if(rank > n) rank = n;
+
+    return sorted[rank - 1];
+}
+
+/* ____________________________________________________________________________
+
+    static void json_string(FILE *out, const char *s)
+
+    Writes a quoted JSON string
+
+    Parameters:
+        out - The output stream
+        s - The string
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void json_string(FILE *out, const char *s) {
+
+    fputc('"', out);
+    for(; s && *s; s++) {
+        if(*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/* ____________________________________________________________________________
+
+    static void measure(const benchmark *b, const bench_options *o,
+                        counters *c, FILE *out, int first)
+
+    Runs a benchmark with warm-up and repetitions and writes its statistics
+    as a JSON object
+
+    Parameters:
+        b - A pointer to the benchmark
+        o - A pointer to the options
+        c - A pointer to the hardware counters
+        out - The JSON output
+        first - 1 for the first result of the list
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void measure(const benchmark *b, const bench_options *o, counters *c, FILE *out, int first) {
+
+    for(int i = 0; i < o->warmup; i++) b->run(b->context);
+
+    double *values = (double *)malloc(sizeof(double) * o->repetitions);
+    if(!values) exit(EXIT_FAILURE);
+
+    counters_start(c);
+    for(int i = 0; i < o->repetitions; i++) {
+        double start = now_ns();
+        b->run(b->context);
+        double elapsed = now_ns() - start;
+        values[i] = b->rate ? b->units / (elapsed * 1e-9) : elapsed / b->units;
+    }
+    counters_stop(c);
+
+    double mean = 0.0;
+    for(int i = 0; i < o->repetitions; i++) mean += values[i];
+    mean /= o->repetitions;
+    qsort(values, o->repetitions, sizeof(double), compare_doubles);
+
+    fprintf(out, "%s    {\"name\": ", first ? "" : ",\n");
+    json_string(out, b->name);
+    fprintf(out, ", \"expression\": ");
+    if(b->expression) json_string(out, b->expression);
+    else fprintf(out, "null");
+    fprintf(out, ", \"unit\": ");
+    json_string(out, b->unit);
+    fprintf(out, ", \"min\": %.6g, \"median\": %.6g, \"p90\": %.6g, \"p99\": %.6g, \"max\": %.6g, \"mean\": %.6g",
+            values[0], percentile(values, o->repetitions, 50), percentile(values, o->repetitions, 90),
+            percentile(values, o->repetitions, 99), values[o->repetitions - 1], mean);
+
+    // counters per unit of work
+    double units = b->units * o->repetitions;
+    if(c->valid) {
+        fprintf(out, ", \"cycles\": %.6g, \"instructions\": %.6g",
+                (double)c->cycles_total / units, (double)c->instructions_total / units);
+    } else {
+        fprintf(out, ", \"cycles\": null, \"instructions\": null");
+    }
+    fprintf(out, "}");
+
+    free(values);
+}
+
+/* ____________________________________________________________________________
+
+    Benchmarked operations
+   ____________________________________________________________________________
+*/
+
+// evaluation of one compiled expression
+typedef struct {
+    program *p;
+    double *xs;
+    double *ys;
+    size_t n;
+} evaluation;
+
+static volatile double sink;
+
+static void run_scalar(void *context) {
+
+    evaluation *e = (evaluation *)context;
+    double sum = 0.0;
+    for(size_t i = 0; i < e->n; i++) sum += evaluate_postfix_expression(e->p, e->xs[i]);
+    sink = sum;
+}
+
+static void run_batch(void *context) {
+
+    evaluation *e = (evaluation *)context;
+    evaluate_postfix_batch(e->p, e->xs, e->ys, e->n);
+    sink = e->ys[e->n / 2];
+}
+
+// the front end of render_graph, every parse reuses the arena like a render
+static void run_parse(void *context) {
+
+    const char *expression = (const char *)context;
+    arena *scratch = arena_create(0);
+    if(!scratch) exit(EXIT_FAILURE);
+
+    for(int i = 0; i < BENCH_PARSES; i++) {
+        arena_reset(scratch);
+        lex_error error;
+        queue_token *tokens = queue_token_create(strlen(expression) + 1, scratch);
+        if(tokens && lex_expression(expression, tokens, &error)) {
+            queue_token *postfix = queue_token_create(tokens->count + 1, scratch);
+            if(postfix) shunting_yard(tokens, postfix, scratch);
+            queue_token_free(&postfix);
+        }
+        queue_token_free(&tokens);
+    }
+
+    arena_free(&scratch);
+}
+
+// output of the axes and labels, no sampling involved
+typedef struct {
+    const char *scratch;
+    double bytes;
+} writer;
+
+static void run_writer(void *context) {
+
+    writer *w = (writer *)context;
+
+    postscript *ps = create_postscript(w->scratch, "x", BENCH_X_MIN, BENCH_X_MAX, -5, 5);
+    if(!ps) exit(EXIT_FAILURE);
+    for(int i = 0; i < BENCH_WRITER_PAGES; i++) {
+        draw_square_axis(ps);
+        draw_ticks_and_labels(ps);
+    }
+    close_postscript(ps);
+
+    struct stat info;
+    w->bytes = stat(w->scratch, &info) == 0 ? (double)info.st_size : 0.0;
+}
+
+// the whole pipeline of main for every expression of the corpus
+static void run_graphs(void *context) {
+
+    const char *scratch = (const char *)context;
+
+    for(int i = 0; corpus[i]; i++) {
+        postscript *ps = create_postscript(scratch, corpus[i], BENCH_X_MIN, BENCH_X_MAX, -5, 5);
+        if(ps) {
+            ps->threads = 1;
+            draw_square_axis(ps);
+            draw_ticks_and_labels(ps);
+            draw_graph(ps);
+            close_postscript(ps);
+        }
+    }
+}
+
+/* ____________________________________________________________________________
+
+    static program *compile_expression(const char *expression)
+
+    Compiles an expression of the corpus like create_postscript does
+
+    Parameters:
+        expression - The expression in the syntax of the command line
+
+    Returns:
+        A pointer to the optimized program or NULL
+   ____________________________________________________________________________
+*/
+static program *compile_expression(const char *expression) {
+
+    return compile_function(expression, NULL);
+}
+
+/* ____________________________________________________________________________
+
+    int main(int argc, char *argv[])
+
+    Benchmark of the parser, the evaluators, the PostScript writer and the
+    whole pipeline. The statistics are written as JSON, so the results of
+    two versions can be compared by diff.
+
+    Parameters:
+        argc - The number of command-line arguments
+        argv - Array of command-line arguments:
+               --warmup=<count> (optional) - Runs before the measurement
+               --repetitions=<count> (optional) - Measured runs
+               --perf (optional) - Counts cycles and instructions by perf_event_open
+               --output=<file> (optional) - The JSON file, stdout by default
+               --scratch=<file> (optional) - Temporary PostScript file
+
+    Returns:
+        0 on success, 1 for invalid arguments
+   ____________________________________________________________________________
+*/
+int main(int argc, char *argv[]) {
+
+    bench_options o = {BENCH_WARMUP, BENCH_REPETITIONS, 0, BENCH_SCRATCH};
+    const char *output = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--warmup=", 9) == 0) {
+            if(sscanf(argv[i] + 9, "%d", &o.warmup) != 1 || o.warmup < 0) return 1;
+        } else if(strncmp(argv[i], "--repetitions=", 14) == 0) {
+            if(sscanf(argv[i] + 14, "%d", &o.repetitions) != 1 || o.repetitions < 1) return 1;
+        } else if(strcmp(argv[i], "--perf") == 0) {
+            o.perf = 1;
+        } else if(strncmp(argv[i], "--output=", 9) == 0) {
+            output = argv[i] + 9;
+        } else if(strncmp(argv[i], "--scratch=", 10) == 0) {
+            o.scratch = argv[i] + 10;
+        } else {
+            fprintf(stderr, "Usage: bench.EXE [--warmup=<count>] [--repetitions=<count>] [--perf] [--output=<file>] [--scratch=<file>]\n");
+            return 1;
+        }
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if(!out) {
+        fprintf(stderr, "Error: Cannot open %s\n", output);
+        return 1;
+    }
+
+    counters c;
+    counters_open(&c, o.perf);
+    if(o.perf && !c.valid) fprintf(stderr, "Warning: perf_event_open is not available.\n");
+
+    // the same x values for every expression
+    evaluation e;
+    e.n = BENCH_SAMPLES;
+    e.xs = (double *)malloc(sizeof(double) * e.n);
+    e.ys = (double *)malloc(sizeof(double) * e.n);
+    if(!e.xs || !e.ys) return 1;
+    for(size_t i = 0; i < e.n; i++) e.xs[i] = BENCH_X_MIN + (BENCH_X_MAX - BENCH_X_MIN) * (double)i / (double)e.n;
+
+    fprintf(out, "{\n  \"format\": %d,\n  \"vecmath\": ", BENCH_FORMAT_VERSION);
+    json_string(out, vecmath_level_name(vecmath_get_level()));
+    fprintf(out, ",\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"results\": [\n", o.warmup, o.repetitions);
+
+    int first = 1;
+    for(int i = 0; corpus[i]; i++) {
+        e.p = compile_expression(corpus[i]);
+        if(!e.p) {
+            fprintf(stderr, "Warning: Cannot compile %s\n", corpus[i]);
+            continue;
+        }
+
+        benchmark b = {"evaluate", corpus[i], "ns/eval", (double)e.n, 0, run_scalar, &e};
+        measure(&b, &o, &c, out, first);
+        first = 0;
+
+        b.name = "evaluate_batch";
+        b.run = run_batch;
+        measure(&b, &o, &c, out, 0);
+
+        // the native code, when the platform supports it
+        jit_program *j = jit_compile(e.p);
+        if(j) {
+            e.p->native = j->function;
+            b.name = "evaluate_jit";
+            b.run = run_scalar;
+            measure(&b, &o, &c, out, 0);
+            e.p->native = NULL;
+            jit_free(&j);
+        }
+
+        benchmark parse = {"parse", corpus[i], "ns/parse", BENCH_PARSES, 0, run_parse, (void *)corpus[i]};
+        measure(&parse, &o, &c, out, 0);
+
+        program_free(&e.p);
+    }
+
+    // the writer reports bytes of the file per second
+    writer w = {o.scratch, 0.0};
+    run_writer(&w);
+    benchmark b = {"writer", NULL, "bytes/s", w.bytes, 1, run_writer, &w};
+    measure(&b, &o, &c, out, first);
+
+    int graphs = 0;
+    while(corpus[graphs]) graphs++;
+    benchmark g = {"graphs", NULL, "graphs/s", graphs, 1, run_graphs, (void *)o.scratch};
+    measure(&g, &o, &c, out, 0);
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(output) fclose(out);
+    counters_close(&c);
+    remove(o.scratch);
+    free(e.xs);
+    free(e.ys);
+
+    return 0;
+}
@@ -0,0 +1,383 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "postfixmath.h"
+#include "ckernel.h"
+
+#ifndef _WIN32
+#define CKERNEL_DLOPEN 1
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+// constants
+#define CKERNEL_PATH_SIZE 4096
+#define CKERNEL_COMMAND_SIZE (3 * CKERNEL_PATH_SIZE)
+#define CKERNEL_COMPILER "gcc -std=c99 -O3 -march=native -fPIC -shared"
+#define CKERNEL_FUNCTION "graph_kernel"
+#define CKERNEL_BATCH "graph_kernel_batch"
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/* ____________________________________________________________________________
+
+    static void write_constant(FILE *out, double value)
+
+    Writes a double constant as a C expression which reads back exactly
+
+    Parameters:
+        out - The output stream
+        value - The constant
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void write_constant(FILE *out, double value) {
+
+    if(isnan(value)) fprintf(out, "NAN");
+    else if(isinf(value)) fprintf(out, value < 0 ? "(-HUGE_VAL)" : "HUGE_VAL");
+    else fprintf(out, "(%.17g)", value);
+}
+
+/* ____________________________________________________________________________
+
+    int ckernel_source(const program *p, FILE *out)
+
+    Writes the C source of a kernel evaluating the program. Every level of
+    the value stack and every shared value becomes a local variable,
+    integer powers use the same chain of multiplications as the
+    interpreter, so the kernel returns the same values as
+    evaluate_postfix_expression.
+
+    Parameters:
+        p - A pointer to the compiled program
+        out - The output stream
+
+    Returns:
+        1 if the source was written, 0 otherwise
+   ____________________________________________________________________________
+*/
+int ckernel_source(const program *p, FILE *out) {
+
+    // sanity check
+    if(!p || !p->code || p->length == 0 || !out) return 0;
+
+    fprintf(out, "#include <stddef.h>\n#include <math.h>\n\n");
+
+    // copy of power_int from postfixmath.c
+    fprintf(out, "static double power_int(double base, int exponent) {\n"
+                 "    unsigned int n = exponent < 0 ? -(unsigned int)exponent : (unsigned int)exponent;\n"
+                 "    double result = 1.0;\n"
+                 "    while(n > 0) {\n"
+                 "        if(n & 1) result *= base;\n"
+                 "        base *= base;\n"
+                 "        n >>= 1;\n"
+                 "    }\n"
+                 "    return exponent < 0 ? 1.0 / result : result;\n"
+                 "}\n\n");
+
+    fprintf(out, "double %s(double x) {\n", CKERNEL_FUNCTION);
+    for(uint i = 0; i < p->depth; i++) fprintf(out, "    double s%u;\n", i);
+    for(uint i = 0; i < p->slots; i++) fprintf(out, "    double t%u;\n", i);
+
+    int sp = -1;
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+
+        switch(in->op) {
+            case OP_CONST:
+                fprintf(out, "    s%d = ", ++sp);
+                write_constant(out, in->value);
+                fprintf(out, ";\n");
+                break;
+            case OP_X: fprintf(out, "    s%d = x;\n", ++sp); break;
+            case OP_ADD: sp--; fprintf(out, "    s%d = s%d + s%d;\n", sp, sp, sp + 1); break;
+            case OP_SUB: sp--; fprintf(out, "    s%d = s%d - s%d;\n", sp, sp, sp + 1); break;
+            case OP_MUL: sp--; fprintf(out, "    s%d = s%d * s%d;\n", sp, sp, sp + 1); break;
+            case OP_DIV: sp--; fprintf(out, "    s%d = s%d / s%d;\n", sp, sp, sp + 1); break;
+            case OP_POW: sp--; fprintf(out, "    s%d = pow(s%d, s%d);\n", sp, sp, sp + 1); break;
+            case OP_NEG: fprintf(out, "    s%d = -s%d;\n", sp, sp); break;
+            case OP_FUNC:
+                fprintf(out, "    s%d = %s(s%d);\n", sp, function_table[in->func].c_name, sp);
+                break;
+            case OP_POWI:
+                fprintf(out, "    s%d = power_int(s%d, %d);\n", sp, sp, (int)in->value);
+                break;
+            case OP_STORE: fprintf(out, "    t%u = s%d;\n", (uint)in->value, sp); break;
+            case OP_LOAD: sp++; fprintf(out, "    s%d = t%u;\n", sp, (uint)in->value); break;
+        }
+    }
+    fprintf(out, "    return s0;\n}\n\n");
+
+    // the sampling loop, inlined by the compiler
+    fprintf(out, "void %s(const double *restrict xs, double *restrict ys, size_t n) {\n"
+                 "    for(size_t i = 0; i < n; i++) ys[i] = %s(xs[i]);\n"
+                 "}\n", CKERNEL_BATCH, CKERNEL_FUNCTION);
+
+    return 1;
+}
+
+#ifdef CKERNEL_DLOPEN
+
+/* ____________________________________________________________________________
+
+    static int make_directory(const char *path)
+
+    Creates a directory together with its missing parents
+
+    Parameters:
+        path - The path of the directory
+
+    Returns:
+        1 if the directory exists afterwards, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int make_directory(const char *path) {
+
+    char buffer[CKERNEL_PATH_SIZE];
+    size_t length = strlen(path);
+    if(length == 0 || length >= sizeof(buffer)) return 0;
+    memcpy(buffer, path, length + 1);
+
+    // create every prefix ending before a slash, then the whole path
+    for(size_t i = 1; i <= length; i++) {
+        if(buffer[i] == '/' || buffer[i] == '\0') {
+            char saved = buffer[i];
+            buffer[i] = '\0';
+            mkdir(buffer, 0755);
+            buffer[i] = saved;
+        }
+    }
+
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+/* ____________________________________________________________________________
+
+    static const char *default_cache_dir(char *buffer, size_t size)
+
+    Finds the directory of the cached kernels, the CKERNEL_CACHE_ENV
+    variable, $XDG_CACHE_HOME/graph-visualizer, ~/.cache/graph-visualizer
+    or /tmp/graph-visualizer in this order
+
+    Parameters:
+        buffer - A buffer for the composed path
+        size - The size of the buffer
+
+    Returns:
+        The path of the directory
+   ____________________________________________________________________________
+*/
+static const char *default_cache_dir(char *buffer, size_t size) {
+
+    const char *dir = getenv(CKERNEL_CACHE_ENV);
+    if(dir && *dir) return dir;
+
+    dir = getenv("XDG_CACHE_HOME");
+    if(dir && *dir) {
+        snprintf(buffer, size, "%s/graph-visualizer", dir);
+        return buffer;
+    }
+
+    dir = getenv("HOME");
+    if(dir && *dir) {
+        snprintf(buffer, size, "%s/.cache/graph-visualizer", dir);
+        return buffer;
+    }
+
+    return "/tmp/graph-visualizer";
+}
+
+/* ____________________________________________________________________________
+
+    static int file_equals(const char *path, const char *data, size_t size)
+
+    Compares the content of a file with a buffer
+
+    Parameters:
+        path - The path of the file
+        data - The expected content
+        size - The size of the expected content
+
+    Returns:
+        1 if the file exists and has the same content, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int file_equals(const char *path, const char *data, size_t size) {
+
+    FILE *f = fopen(path, "rb");
+    if(!f) return 0;
+
+    char *content = (char *)malloc(size + 1);
+    int equal = content && fread(content, 1, size + 1, f) == size && memcmp(content, data, size) == 0;
+
+    free(content);
+    fclose(f);
+
+    return equal;
+}
+
+/* ____________________________________________________________________________
+
+    static int compile_kernel(const char *source, size_t size,
+                              const char *c_path, const char *so_path)
+
+    Compiles the source of a kernel into the cache. The files are written
+    under temporary names and renamed, the object before its source, so
+    concurrent renders never see a partial object.
+
+    Parameters:
+        source - The C source of the kernel
+        size - The length of the source
+        c_path - The cached path of the source
+        so_path - The cached path of the shared object
+
+    Returns:
+        1 if the kernel was compiled, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int compile_kernel(const char *source, size_t size, const char *c_path, const char *so_path) {
+
+    char c_tmp[CKERNEL_PATH_SIZE], so_tmp[CKERNEL_PATH_SIZE], command[CKERNEL_COMMAND_SIZE];
+    long pid = (long)getpid();
+
+    // the address of the local buffer tells apart the threads of the process
+    unsigned long thread = (unsigned long)(uintptr_t)command;
+
+    if(snprintf(c_tmp, sizeof(c_tmp), "%s.%ld.%lx.c", so_path, pid, thread) >= (int)sizeof(c_tmp)) return 0;
+    if(snprintf(so_tmp, sizeof(so_tmp), "%s.%ld.%lx.so", so_path, pid, thread) >= (int)sizeof(so_tmp)) return 0;
+
+    // the paths are quoted for the shell
+    if(strchr(c_tmp, '\'')) return 0;
+
+    FILE *f = fopen(c_tmp, "wb");
+    if(!f) return 0;
+    int written = fwrite(source, 1, size, f) == size;
+    if(fclose(f) != 0 || !written) {
+        remove(c_tmp);
+        return 0;
+    }
+
+    snprintf(command, sizeof(command), CKERNEL_COMPILER " -o '%s' '%s' -lm", so_tmp, c_tmp);
+    int compiled = system(command) == 0;
+
+    if(compiled && rename(so_tmp, so_path) == 0 && rename(c_tmp, c_path) == 0) return 1;
+
+    remove(so_tmp);
+    remove(c_tmp);
+    return 0;
+}
+
+#endif // CKERNEL_DLOPEN
+
+/* ____________________________________________________________________________
+
+    ckernel *ckernel_load(const program *p, const char *cache_dir)
+
+    Loads the compiled kernel of a program, the kernel is compiled first
+    if the cache does not contain it yet
+
+    Parameters:
+        p - A pointer to the compiled program
+        cache_dir - The directory of the cached kernels, NULL for the default
+
+    Returns:
+        A pointer to the loaded kernel or NULL if it cannot be compiled or
+        loaded, or dlopen is not available
+   ____________________________________________________________________________
+*/
+ckernel *ckernel_load(const program *p, const char *cache_dir) {
+
+    // sanity check
+    if(!p || !p->code || p->length == 0) return NULL;
+
+#ifdef CKERNEL_DLOPEN
+    // generate the source, it is the key of the cache
+    char *source = NULL;
+    size_t size = 0;
+    FILE *stream = open_memstream(&source, &size);
+    if(!stream) return NULL;
+    int generated = ckernel_source(p, stream);
+    if(fclose(stream) != 0 || !generated) {
+        free(source);
+        return NULL;
+    }
+
+    // FNV-1a hash of the source names the cached files
+    uint64_t hash = FNV_OFFSET;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)source[i];
+        hash *= FNV_PRIME;
+    }
+
+    char dir_buffer[CKERNEL_PATH_SIZE], c_path[CKERNEL_PATH_SIZE], so_path[CKERNEL_PATH_SIZE];
+    if(!cache_dir) cache_dir = default_cache_dir(dir_buffer, sizeof(dir_buffer));
+    if(snprintf(c_path, sizeof(c_path), "%s/k%016llx.c", cache_dir, (unsigned long long)hash) >= (int)sizeof(c_path) ||
+       snprintf(so_path, sizeof(so_path), "%s/k%016llx.so", cache_dir, (unsigned long long)hash) >= (int)sizeof(so_path)) {
+        free(source);
+        return NULL;
+    }
+
+    // the cached source guards against collisions of the hash
+    int ready = file_equals(c_path, source, size);
+    if(!ready) ready = make_directory(cache_dir) && compile_kernel(source, size, c_path, so_path);
+    free(source);
+    if(!ready) return NULL;
+
+    ckernel *k = (ckernel *)malloc(sizeof(ckernel));
+    if(!k) return NULL;
+
+    k->handle = dlopen(so_path, RTLD_NOW | RTLD_LOCAL);
+    if(!k->handle) {
+        free(k);
+        return NULL;
+    }
+
+    // object pointers cannot be cast to functions in ISO C
+    void *function = dlsym(k->handle, CKERNEL_FUNCTION);
+    void *batch = dlsym(k->handle, CKERNEL_BATCH);
+    if(!function || !batch) {
+        dlclose(k->handle);
+        free(k);
+        return NULL;
+    }
+    memcpy(&k->function, &function, sizeof(k->function));
+    memcpy(&k->batch, &batch, sizeof(k->batch));
+
+    return k;
+#else
+    (void)cache_dir;
+    return NULL;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    void ckernel_free(ckernel **k)
+
+    Unloads the compiled kernel, the cached files are kept
+
+    Parameters:
+        k - A double pointer to the kernel to be freed
+
+    Returns:
+        Nothing. The pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void ckernel_free(ckernel **k) {
+
+    // sanity check
+    if(!k || !*k) return;
+
+#ifdef CKERNEL_DLOPEN
+    dlclose((*k)->handle);
+#endif
+    free(*k);
+    *k = NULL;
+}
@@ -0,0 +1,40 @@
+#ifndef CKERNEL_H
+#define CKERNEL_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "postfixmath.h"
+
+// environment variable overriding the directory of the compiled kernels
+#define CKERNEL_CACHE_ENV "GRAPH_KERNEL_CACHE"
+
+/* ____________________________________________________________________________
+
+    Compiled C Kernel of a Program
+
+    The program is translated into a C source file with a scalar and a
+    sampling loop entry point, compiled by the system gcc into a shared
+    object and loaded by dlopen. The objects are cached on disk, keyed by
+    the generated source, so the same expression is compiled only once.
+   ____________________________________________________________________________
+*/
+
+typedef struct {
+    void *handle;
+    double (*function)(double);
+    void (*batch)(const double *xs, double *ys, size_t n);
+} ckernel;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int ckernel_source(const program *p, FILE *out);
+
+ckernel *ckernel_load(const program *p, const char *cache_dir);
+
+void ckernel_free(ckernel **k);
+
+#endif //CKERNEL_H
@@ -0,0 +1,420 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "daemon.h"
+#include "exprcache.h"
+
+// constants
+#define DAEMON_BACKLOG 64
+#define DAEMON_REQUEST_SIZE 65536
+#define DAEMON_REPLY_SIZE (ERROR_SIZE + 64)
+#define DAEMON_CONNECTIONS 64
+#define DAEMON_TIMEOUT 10
+
+#ifndef _WIN32
+
+// set by SIGINT and SIGTERM, read only by the thread waiting in accept
+static volatile sig_atomic_t daemon_stop = 0;
+
+struct daemon_state;
+
+// a client served by its own thread
+typedef struct {
+    int fd;                     // socket of the client, -1 for a free slot
+    struct daemon_state *state;
+} daemon_client;
+
+// the connections served at the same time, they share the options and the
+// cache of compiled functions
+typedef struct daemon_state {
+    const render_options *options;
+    daemon_client clients[DAEMON_CONNECTIONS];
+    int active;                 // number of the used slots
+    pthread_mutex_t lock;       // guards the slots
+    pthread_cond_t finished;    // signaled when a connection ends
+} daemon_state;
+
+/* ____________________________________________________________________________
+
+    static void daemon_signal(int signal_number)
+
+    Handles the signals which stop the daemon
+
+    Parameters:
+        signal_number - The received signal
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void daemon_signal(int signal_number) {
+
+    (void)signal_number;
+    daemon_stop = 1;
+}
+
+/* ____________________________________________________________________________
+
+    static int send_all(int fd, const char *data, size_t size)
+
+    Sends the whole data to the client, a closed connection does not raise
+    SIGPIPE
+
+    Parameters:
+        fd - The socket of the client
+        data - The data to send
+        size - The number of bytes
+
+    Returns:
+        1 if everything is sent, 0 if the connection fails
+   ____________________________________________________________________________
+*/
+static int send_all(int fd, const char *data, size_t size) {
+
+    size_t sent = 0;
+    while(sent < size) {
+        ssize_t result = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+        if(result < 0 && errno == EINTR) continue;
+        if(result <= 0) return 0;
+        sent += (size_t)result;
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static int daemon_request(int fd, char *line, const render_options *o)
+
+    Renders the graph of one request and replies to the client, the reply
+    is a line "<code> OK" or "<code> Error: <message>", a graph requested
+    into the out-file "-" is sent back as "0 <size>" followed by its bytes,
+    "-.ppm" and "-.pgm" send back a raster image
+
+    Parameters:
+        fd - The socket of the client
+        line - The request <func> <out-file> [<limits>], modified in place
+        o - The options of the rendering with the cache of the daemon
+
+    Returns:
+        1 if the reply is sent or the line is empty, 0 if the connection fails
+   ____________________________________________________________________________
+*/
+static int daemon_request(int fd, char *line, const render_options *o) {
+
+    job j;
+    if(!parse_job(line, &j)) return 1;
+
+    char reply[DAEMON_REPLY_SIZE];
+    char *body = NULL;
+    size_t size = 0;
+
+    if(j.status == SUCCESS) {
+        // the graph is kept in memory when it is sent back
+        FILE *stream = NULL;
+        if(strcmp(j.outfile, "-") == 0 || strcmp(j.outfile, "-.ppm") == 0 || strcmp(j.outfile, "-.pgm") == 0) {
+            stream = open_memstream(&body, &size);
+            if(!stream) {
+                j.status = ERR_FILE_ERROR;
+                snprintf(j.error, ERROR_SIZE, "Failed to create the response.");
+            }
+        }
+        if(j.status == SUCCESS) {
+            j.status = render_graph(j.functions, j.outfile, stream, j.limits, o, j.error);
+        }
+    }
+
+    int ok;
+    if(j.status != SUCCESS) {
+        snprintf(reply, sizeof(reply), "%d Error: %s\n", j.status, j.error);
+        ok = send_all(fd, reply, strlen(reply));
+    } else if(body) {
+        snprintf(reply, sizeof(reply), "%d %zu\n", SUCCESS, size);
+        ok = send_all(fd, reply, strlen(reply)) && send_all(fd, body, size);
+    } else {
+        snprintf(reply, sizeof(reply), "%d OK\n", SUCCESS);
+        ok = send_all(fd, reply, strlen(reply));
+    }
+    free(body);
+
+    return ok;
+}
+
+/* ____________________________________________________________________________
+
+    static void daemon_requests(int fd, const render_options *o)
+
+    Serves the requests of a client, one per line, until it closes the
+    connection or stays silent for DAEMON_TIMEOUT seconds
+
+    Parameters:
+        fd - The socket of the client
+        o - The options of the rendering with the cache of the daemon
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void daemon_requests(int fd, const render_options *o) {
+
+    char *buffer = (char *)malloc(DAEMON_REQUEST_SIZE + 1);
+    if(!buffer) return;
+    size_t length = 0;
+
+    // a stop of the daemon shuts down the receiving side of the socket
+    for(;;) {
+        ssize_t received = recv(fd, buffer + length, DAEMON_REQUEST_SIZE - length, 0);
+        if(received < 0 && errno == EINTR) continue;
+        if(received <= 0) break;
+        length += (size_t)received;
+        buffer[length] = '\0';
+
+        // serve every complete line
+        char *line = buffer;
+        char *end;
+        int ok = 1;
+        while(ok && (end = strchr(line, '\n'))) {
+            *end = '\0';
+            ok = daemon_request(fd, line, o);
+            line = end + 1;
+        }
+        if(!ok) break;
+
+        // keep the incomplete line for the next receive
+        length -= (size_t)(line - buffer);
+        memmove(buffer, line, length);
+        if(length == DAEMON_REQUEST_SIZE) {
+            char reply[DAEMON_REPLY_SIZE];
+            snprintf(reply, sizeof(reply), "%d Error: The request is too long.\n", ERR_INVALID_ARGUMENTS);
+            send_all(fd, reply, strlen(reply));
+            break;
+        }
+    }
+
+    free(buffer);
+}
+
+/* ____________________________________________________________________________
+
+    static void *daemon_connection(void *argument)
+
+    Serves a client in its own thread with its own arena, then closes the
+    socket and frees the slot of the client
+
+    Parameters:
+        argument - A pointer to the daemon_client
+
+    Returns:
+        NULL
+   ____________________________________________________________________________
+*/
+static void *daemon_connection(void *argument) {
+
+    daemon_client *client = (daemon_client *)argument;
+    daemon_state *d = client->state;
+
+    render_options options = *d->options;
+    options.scratch = arena_create(0);
+    daemon_requests(client->fd, &options);
+    arena_free(&options.scratch);
+
+    // the socket is closed under the lock, so a stop never shuts down a
+    // reused descriptor
+    pthread_mutex_lock(&d->lock);
+    close(client->fd);
+    client->fd = -1;
+    d->active--;
+    pthread_cond_signal(&d->finished);
+    pthread_mutex_unlock(&d->lock);
+
+    return NULL;
+}
+
+/* ____________________________________________________________________________
+
+    static int daemon_start(daemon_state *d, int fd)
+
+    Starts the thread serving a new client, it waits for a free slot when
+    DAEMON_CONNECTIONS clients are served. A client silent for
+    DAEMON_TIMEOUT seconds, or not reading its replies, is dropped, so no
+    client holds its slot for long.
+
+    Parameters:
+        d - A pointer to the state of the daemon
+        fd - The socket of the client
+
+    Returns:
+        1 if the thread runs, 0 if the client is closed instead
+   ____________________________________________________________________________
+*/
+static int daemon_start(daemon_state *d, int fd) {
+
+    struct timeval timeout = {DAEMON_TIMEOUT, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    pthread_mutex_lock(&d->lock);
+    while(d->active == DAEMON_CONNECTIONS) pthread_cond_wait(&d->finished, &d->lock);
+    daemon_client *client = d->clients;
+    while(client->fd >= 0) client++;
+    client->fd = fd;
+    d->active++;
+    pthread_mutex_unlock(&d->lock);
+
+    // the signals stay with the thread waiting in accept
+    sigset_t signals, previous;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    int started = pthread_create(&thread, &attributes, daemon_connection, client) == 0;
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if(!started) {
+        pthread_mutex_lock(&d->lock);
+        close(fd);
+        client->fd = -1;
+        d->active--;
+        pthread_mutex_unlock(&d->lock);
+    }
+
+    return started;
+}
+
+#endif // _WIN32
+
+/* ____________________________________________________________________________
+
+    int serve_daemon(const char *socket_path, const render_options *o)
+
+    Listens on a Unix domain socket and renders the requests of the clients
+    until SIGINT or SIGTERM, the compiled functions are kept in a cache of
+    DAEMON_CACHE_SIZE expressions so repeated functions skip their parsing
+    and compilation. Every client is served by its own thread, up to
+    DAEMON_CONNECTIONS at the same time, and every render samples with the
+    threads of the options
+
+    Parameters:
+        socket_path - The path of the socket, a stale socket is replaced
+        o - The options of the rendering
+
+    Returns:
+        SUCCESS (0) after a stop by a signal
+        ERR_FILE_ERROR if the socket cannot be created
+        ERR_INVALID_ARGUMENTS if the platform has no Unix domain sockets
+   ____________________________________________________________________________
+*/
+int serve_daemon(const char *socket_path, const render_options *o) {
+
+#ifdef _WIN32
+    (void)socket_path;
+    (void)o;
+    fprintf(stderr, "Error: The daemon is not supported on this platform.\n");
+    return ERR_INVALID_ARGUMENTS;
+#else
+    // sanity check
+    if(!socket_path || !o) return ERR_INVALID_ARGUMENTS;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: The socket path %s is too long.\n", socket_path);
+        return ERR_INVALID_ARGUMENTS;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0) {
+        fprintf(stderr, "Error: Failed to create the socket.\n");
+        return ERR_FILE_ERROR;
+    }
+
+    // replace a socket left by a daemon which no longer runs
+    if(connect(listener, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "Error: A daemon already listens on %s\n", socket_path);
+        close(listener);
+        return ERR_FILE_ERROR;
+    }
+    close(listener);
+    unlink(socket_path);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+       listen(listener, DAEMON_BACKLOG) != 0) {
+        fprintf(stderr, "Error: Failed to listen on %s\n", socket_path);
+        if(listener >= 0) close(listener);
+        return ERR_FILE_ERROR;
+    }
+
+    // the signals interrupt accept instead of restarting it
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_signal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    render_options daemon_options = *o;
+    daemon_options.dump = 0;
+    daemon_options.verbose = 0;
+    daemon_options.cache = expression_cache_create(DAEMON_CACHE_SIZE);
+    daemon_options.scratch = NULL;
+
+    daemon_state d;
+    d.options = &daemon_options;
+    d.active = 0;
+    for(int i = 0; i < DAEMON_CONNECTIONS; i++) {
+        d.clients[i].fd = -1;
+        d.clients[i].state = &d;
+    }
+    pthread_mutex_init(&d.lock, NULL);
+    pthread_cond_init(&d.finished, NULL);
+
+    printf("Listening on %s\n", socket_path);
+    fflush(stdout);
+
+    while(!daemon_stop) {
+        int client = accept(listener, NULL, NULL);
+        if(client < 0 && (errno == EINTR || errno == ECONNABORTED)) continue;
+        if(client < 0) break;
+
+        daemon_start(&d, client);
+    }
+
+    // wake the connections waiting for requests, then wait for their renders
+    pthread_mutex_lock(&d.lock);
+    for(int i = 0; i < DAEMON_CONNECTIONS; i++) {
+        if(d.clients[i].fd >= 0) shutdown(d.clients[i].fd, SHUT_RD);
+    }
+    while(d.active > 0) pthread_cond_wait(&d.finished, &d.lock);
+    pthread_mutex_unlock(&d.lock);
+    pthread_cond_destroy(&d.finished);
+    pthread_mutex_destroy(&d.lock);
+
+    if(daemon_options.cache) {
+        printf("Cache: %llu hits, %llu misses\n", daemon_options.cache->hits, daemon_options.cache->misses);
+    }
+    expression_cache_free(&daemon_options.cache);
+    close(listener);
+    unlink(socket_path);
+
+    return SUCCESS;
+#endif
+}
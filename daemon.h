@@ -0,0 +1,17 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "render.h"
+
+// the most compiled functions kept by the daemon
+#define DAEMON_CACHE_SIZE 256
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int serve_daemon(const char *socket_path, const render_options *o);
+
+#endif //DAEMON_H
@@ -0,0 +1,188 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#define EXPORT_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "export.h"
+
+/* ____________________________________________________________________________
+
+    static size_t align8(size_t size)
+
+    Rounds a size up to a multiple of 8 bytes
+
+    Parameters:
+        size - The size
+
+    Returns:
+        The aligned size
+   ____________________________________________________________________________
+*/
+static size_t align8(size_t size) {
+
+    return (size + 7) & ~(size_t)7;
+}
+
+/* ____________________________________________________________________________
+
+    size_t export_size(curve **curves, size_t count, export_type type)
+
+    Computes the bytes of the export of the curves
+
+    Parameters:
+        curves - The curves, a NULL curve is exported without samples
+        count - The number of curves
+        type - The type of the exported values
+
+    Returns:
+        The size of the export
+   ____________________________________________________________________________
+*/
+size_t export_size(curve **curves, size_t count, export_type type) {
+
+    size_t value_size = type == EXPORT_FLOAT32 ? sizeof(float) : sizeof(double);
+    size_t size = sizeof(export_header) + count * sizeof(export_curve);
+
+    for(size_t k = 0; k < count; k++) {
+        size_t samples = curves[k] ? curves[k]->count : 0;
+        size += align8(2 * value_size * samples) + align8(samples);
+    }
+
+    return size;
+}
+
+/* ____________________________________________________________________________
+
+    static void export_fill(unsigned char *base, size_t size, export_type type,
+                            const viewport *v, curve **curves, size_t count)
+
+    Writes the export of the curves into a zeroed buffer of export_size
+    bytes aligned to 8 bytes
+
+    Parameters:
+        base - The buffer
+        size - The size of the buffer
+        type - The type of the exported values
+        v - The viewport deciding which samples are out of range
+        curves - The curves
+        count - The number of curves
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void export_fill(unsigned char *base, size_t size, export_type type, const viewport *v, curve **curves, size_t count) {
+
+    export_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, EXPORT_MAGIC, sizeof(header.magic));
+    header.version = EXPORT_VERSION;
+    header.type = (uint32_t)type;
+    header.value_size = type == EXPORT_FLOAT32 ? sizeof(float) : sizeof(double);
+    header.curve_count = (uint32_t)count;
+    header.size = size;
+    header.x_min = v->x_min;
+    header.x_max = v->x_max;
+    header.y_min = v->y_min;
+    header.y_max = v->y_max;
+
+    size_t offset = sizeof(export_header) + count * sizeof(export_curve);
+    for(size_t k = 0; k < count; k++) {
+        const curve *c = curves[k];
+        export_curve entry;
+        entry.count = c ? c->count : 0;
+        entry.points = offset;
+        offset += align8(2 * header.value_size * entry.count);
+        entry.flags = offset;
+        offset += align8(entry.count);
+        memcpy(base + sizeof(export_header) + k * sizeof(export_curve), &entry, sizeof(entry));
+
+        // the pairs of x and y, then the flags
+        unsigned char *flags = base + entry.flags;
+        for(size_t i = 0; i < entry.count; i++) {
+            if(type == EXPORT_FLOAT32) {
+                float *points = (float *)(base + entry.points);
+                points[2 * i] = (float)c->x[i];
+                points[2 * i + 1] = (float)c->y[i];
+            } else {
+                double *points = (double *)(base + entry.points);
+                points[2 * i] = c->x[i];
+                points[2 * i + 1] = c->y[i];
+            }
+            if(isnan(c->y[i])) flags[i] = EXPORT_FLAG_NAN;
+            else if(!sample_visible(v, c->y[i])) flags[i] = EXPORT_FLAG_OUT_OF_RANGE;
+        }
+    }
+
+    memcpy(base, &header, sizeof(header));
+}
+
+/* ____________________________________________________________________________
+
+    int export_samples(const char *target, export_type type, const viewport *v,
+                       curve **curves, size_t count)
+
+    Exports the samples of the curves into a file, or into a POSIX shared
+    memory segment when the target is "shm:<name>". The file or segment
+    is replaced and sized to the export, which is written through a
+    mapping, so a consumer maps the same pages without a copy.
+
+    Parameters:
+        target - The path of the file or "shm:" followed by the segment name
+        type - The type of the exported values
+        v - The viewport deciding which samples are out of range
+        curves - The curves in the order of the functions
+        count - The number of curves
+
+    Returns:
+        1 on success, 0 if the target cannot be created or written
+   ____________________________________________________________________________
+*/
+int export_samples(const char *target, export_type type, const viewport *v, curve **curves, size_t count) {
+
+    // sanity check
+    if(!target || !v || (!curves && count > 0)) return 0;
+
+    size_t size = export_size(curves, count, type);
+    int shared = strncmp(target, EXPORT_SHM_PREFIX, strlen(EXPORT_SHM_PREFIX)) == 0;
+
+#ifdef EXPORT_MMAP
+    int fd;
+    if(shared) fd = shm_open(target + strlen(EXPORT_SHM_PREFIX), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    else fd = open(target, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return 0;
+
+    // the truncated file is extended by zeros
+    if(ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return 0;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED) return 0;
+
+    export_fill((unsigned char *)base, size, type, v, curves, count);
+    return munmap(base, size) == 0;
+#else
+    // shared memory segments need mmap
+    if(shared) return 0;
+
+    unsigned char *base = (unsigned char *)calloc(size, 1);
+    if(!base) return 0;
+    export_fill(base, size, type, v, curves, count);
+
+    FILE *file = fopen(target, "wb");
+    int written = file && fwrite(base, 1, size, file) == size;
+    if(file && fclose(file) != 0) written = 0;
+    free(base);
+
+    return written;
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sampler.h"
+
+// constants
+#define EXPORT_MAGIC "GVSAMPL1"
+#define EXPORT_VERSION 1
+#define EXPORT_SHM_PREFIX "shm:"
+
+// flags of a sample
+#define EXPORT_FLAG_NAN 1           // the function is not defined at x
+#define EXPORT_FLAG_OUT_OF_RANGE 2  // y lies outside of the viewport
+
+/* ____________________________________________________________________________
+
+    Sample Export
+
+    The samples of the curves as packed binary arrays which a consumer
+    maps without parsing. The export starts with an export_header and a
+    table of one export_curve per function, each curve points at its
+    x, y pairs and its flag bytes, all offsets count from the start of the
+    export and are aligned to 8 bytes. Values are in the byte order of the
+    machine.
+   ____________________________________________________________________________
+*/
+
+// types of the exported values
+typedef enum {
+    EXPORT_FLOAT64,
+    EXPORT_FLOAT32
+} export_type;
+
+typedef struct {
+    char magic[8];          // EXPORT_MAGIC without its terminator
+    uint32_t version;
+    uint32_t type;          // export_type of x and y
+    uint32_t value_size;    // bytes of one x or y
+    uint32_t curve_count;
+    uint64_t size;          // bytes of the whole export
+    double x_min;
+    double x_max;
+    double y_min;
+    double y_max;
+} export_header;
+
+typedef struct {
+    uint64_t count;         // samples of the curve
+    uint64_t points;        // offset of the x, y pairs
+    uint64_t flags;         // offset of one byte of EXPORT_FLAG_* per sample
+} export_curve;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+size_t export_size(curve **curves, size_t count, export_type type);
+
+int export_samples(const char *target, export_type type, const viewport *v, curve **curves, size_t count);
+
+#endif //EXPORT_H
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "exprcache.h"
+#include "stats.h"
+
+// constants
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// the connections of the daemon share the cache, the build without the
+// daemon has no threads
+#ifndef _WIN32
+#define CACHE_INIT(m) pthread_mutex_init(m, NULL)
+#define CACHE_DESTROY(m) pthread_mutex_destroy(m)
+#define CACHE_LOCK(m) pthread_mutex_lock(m)
+#define CACHE_UNLOCK(m) pthread_mutex_unlock(m)
+#else
+#define CACHE_INIT(m)
+#define CACHE_DESTROY(m)
+#define CACHE_LOCK(m)
+#define CACHE_UNLOCK(m)
+#endif
+
+/* ____________________________________________________________________________
+
+    static size_t hash_key(const char *key)
+
+    Computes the FNV-1a hash of a key
+
+    Parameters:
+        key - The terminated key
+
+    Returns:
+        The hash of the key
+   ____________________________________________________________________________
+*/
+static size_t hash_key(const char *key) {
+
+    unsigned long long hash = FNV_OFFSET;
+    for(const unsigned char *k = (const unsigned char *)key; *k; k++) {
+        hash = (hash ^ *k) * FNV_PRIME;
+    }
+
+    return (size_t)hash;
+}
+
+/* ____________________________________________________________________________
+
+    static void entry_unlink(expression_cache *c, cache_entry *e)
+
+    Removes an entry from the list of recently used entries
+
+    Parameters:
+        c - A pointer to the cache
+        e - The entry
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void entry_unlink(expression_cache *c, cache_entry *e) {
+
+    if(e->newer) e->newer->older = e->older;
+    else c->newest = e->older;
+    if(e->older) e->older->newer = e->newer;
+    else c->oldest = e->newer;
+    e->newer = NULL;
+    e->older = NULL;
+}
+
+/* ____________________________________________________________________________
+
+    static void entry_touch(expression_cache *c, cache_entry *e)
+
+    Moves an entry to the front of the list of recently used entries
+
+    Parameters:
+        c - A pointer to the cache
+        e - The entry, linked or not
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void entry_touch(expression_cache *c, cache_entry *e) {
+
+    if(c->newest == e) return;
+    if(e->newer || e->older || c->oldest == e) entry_unlink(c, e);
+
+    e->older = c->newest;
+    if(c->newest) c->newest->newer = e;
+    c->newest = e;
+    if(!c->oldest) c->oldest = e;
+}
+
+/* ____________________________________________________________________________
+
+    static void entry_free(cache_entry *e)
+
+    Frees an entry with its program and native code
+
+    Parameters:
+        e - The entry
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void entry_free(cache_entry *e) {
+
+    CACHE_DESTROY(&e->lock);
+    program_free(&e->func);
+    jit_free(&e->jit);
+    ckernel_free(&e->kernel);
+    free(e->key);
+    free(e);
+}
+
+/* ____________________________________________________________________________
+
+    static int cache_evict(expression_cache *c)
+
+    Removes the least recently used entry which no render holds from the
+    cache
+
+    Parameters:
+        c - A pointer to the cache
+
+    Returns:
+        1 if an entry is evicted, 0 if every entry is held
+   ____________________________________________________________________________
+*/
+static int cache_evict(expression_cache *c) {
+
+    cache_entry *e = c->oldest;
+    while(e && e->users > 0) e = e->newer;
+    if(!e) return 0;
+
+    // remove it from its bucket
+    cache_entry **link = &c->buckets[hash_key(e->key) & c->mask];
+    while(*link != e) link = &(*link)->chain;
+    *link = e->chain;
+
+    entry_unlink(c, e);
+    entry_free(e);
+    c->count--;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    expression_cache *expression_cache_create(size_t capacity)
+
+    Creates an empty cache of compiled expressions
+
+    Parameters:
+        capacity - The most expressions kept, the least recently used one
+                   is evicted first
+
+    Returns:
+        A pointer to the cache or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+expression_cache *expression_cache_create(size_t capacity) {
+
+    // sanity check
+    if(capacity == 0) return NULL;
+
+    expression_cache *c = (expression_cache *)calloc(1, sizeof(expression_cache));
+    if(!c) return NULL;
+
+    // at least two buckets per entry keep the chains short
+    size_t buckets = 1;
+    while(buckets < 2 * capacity) buckets *= 2;
+    c->buckets = (cache_entry **)calloc(buckets, sizeof(cache_entry *));
+    if(!c->buckets) {
+        free(c);
+        return NULL;
+    }
+    c->mask = buckets - 1;
+    c->capacity = capacity;
+    CACHE_INIT(&c->lock);
+
+    return c;
+}
+
+/* ____________________________________________________________________________
+
+    program *expression_cache_get(expression_cache *c, const char *key, backend b)
+
+    Returns a copy of the compiled function, the function is parsed and
+    compiled only when it is not cached yet, the native code of the
+    backend is generated once per entry as well. The entry stays pinned
+    until the copy is freed and expression_cache_release is called for
+    the key.
+
+    Parameters:
+        c - A pointer to the cache
+        key - The function as normalized by format_tokens
+        b - The backend whose native code the copy calls, it has no native
+            code when the backend is not available
+
+    Returns:
+        A pointer to a new program which borrows the native code of the
+        cache entry, or NULL if the function cannot be compiled, nothing
+        is pinned then
+   ____________________________________________________________________________
+*/
+program *expression_cache_get(expression_cache *c, const char *key, backend b) {
+
+    // sanity check
+    if(!c || !key) return NULL;
+
+    CACHE_LOCK(&c->lock);
+    size_t bucket = hash_key(key) & c->mask;
+    cache_entry *e = c->buckets[bucket];
+    while(e && strcmp(e->key, key) != 0) e = e->chain;
+
+    if(e) {
+        c->hits++;
+    } else {
+        c->misses++;
+
+        e = (cache_entry *)calloc(1, sizeof(cache_entry));
+        if(!e) {
+            CACHE_UNLOCK(&c->lock);
+            return NULL;
+        }
+        CACHE_INIT(&e->lock);
+        e->key = (char *)malloc(strlen(key) + 1);
+        if(e->key) strcpy(e->key, key);
+        e->func = compile_function(key, NULL);
+        if(!e->key || !e->func) {
+            entry_free(e);
+            CACHE_UNLOCK(&c->lock);
+            return NULL;
+        }
+
+        if(c->count >= c->capacity) cache_evict(c);
+        e->chain = c->buckets[bucket];
+        c->buckets[bucket] = e;
+        c->count++;
+    }
+    entry_touch(c, e);
+    e->users++;
+    CACHE_UNLOCK(&c->lock);
+
+    // generate the native code of the backend on its first use, other
+    // functions are served meanwhile
+    stats_mark start = stats_now();
+    CACHE_LOCK(&e->lock);
+    if(b == BACKEND_JIT && !e->jit) e->jit = jit_compile(e->func);
+    if(b == BACKEND_C && !e->kernel) e->kernel = ckernel_load(e->func, NULL);
+    CACHE_UNLOCK(&e->lock);
+    stats_phase(PHASE_COMPILE, start);
+
+    // the program of the entry is never changed after it is compiled
+    program *p = program_copy(e->func);
+    if(!p) {
+        expression_cache_release(c, key);
+        return NULL;
+    }
+
+    p->native = NULL;
+    p->native_batch = NULL;
+    if(b == BACKEND_JIT && e->jit) {
+        p->native = e->jit->function;
+    } else if(b == BACKEND_C && e->kernel) {
+        p->native = e->kernel->function;
+        p->native_batch = e->kernel->batch;
+    }
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    void expression_cache_release(expression_cache *c, const char *key)
+
+    Unpins the entry of a function after its program is freed, the entry
+    may be evicted again once no render holds it
+
+    Parameters:
+        c - A pointer to the cache
+        key - The key passed to expression_cache_get
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void expression_cache_release(expression_cache *c, const char *key) {
+
+    // sanity check
+    if(!c || !key) return;
+
+    CACHE_LOCK(&c->lock);
+    cache_entry *e = c->buckets[hash_key(key) & c->mask];
+    while(e && strcmp(e->key, key) != 0) e = e->chain;
+    if(e && e->users > 0) e->users--;
+
+    // entries kept over the capacity while they were held
+    while(c->count > c->capacity && cache_evict(c));
+    CACHE_UNLOCK(&c->lock);
+}
+
+/* ____________________________________________________________________________
+
+    void expression_cache_free(expression_cache **c)
+
+    Frees the cache with all its entries
+
+    Parameters:
+        c - A double pointer to the cache to be freed
+
+    Returns:
+        Nothing. The cache pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void expression_cache_free(expression_cache **c) {
+
+    // sanity check
+    if(!c || !*c) return;
+
+    while((*c)->oldest) {
+        (*c)->oldest->users = 0;
+        cache_evict(*c);
+    }
+    CACHE_DESTROY(&(*c)->lock);
+    free((*c)->buckets);
+    free(*c);
+    *c = NULL;
+}
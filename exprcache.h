@@ -0,0 +1,65 @@
+#ifndef EXPRCACHE_H
+#define EXPRCACHE_H
+
+#include <stddef.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "postfixmath.h"
+#include "postscript.h"
+
+/* ____________________________________________________________________________
+
+    Cache of Compiled Expressions
+
+    The cache is shared by the connections of the daemon. Every program
+    returned by expression_cache_get borrows the native code of its
+    entry, so the entry is pinned until expression_cache_release and the
+    eviction passes over pinned entries.
+   ____________________________________________________________________________
+*/
+
+// a compiled function with the native code of the backends used so far
+typedef struct cache_entry {
+    char *key;                  // the function as normalized by format_tokens
+    program *func;
+    jit_program *jit;
+    ckernel *kernel;
+    unsigned int users;         // renders holding a program of the entry
+#ifndef _WIN32
+    pthread_mutex_t lock;       // guards the generation of the native code
+#endif
+    struct cache_entry *newer;  // the list from the most to the least recently used
+    struct cache_entry *older;
+    struct cache_entry *chain;  // the next entry of the same bucket
+} cache_entry;
+
+typedef struct {
+    cache_entry **buckets;
+    size_t mask;                // number of buckets minus one
+    cache_entry *newest;
+    cache_entry *oldest;
+    size_t count;
+    size_t capacity;            // the most entries before the oldest is evicted
+    unsigned long long hits;
+    unsigned long long misses;
+#ifndef _WIN32
+    pthread_mutex_t lock;       // guards the buckets, the list and the counts
+#endif
+} expression_cache;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+expression_cache *expression_cache_create(size_t capacity);
+
+program *expression_cache_get(expression_cache *c, const char *key, backend b);
+
+void expression_cache_release(expression_cache *c, const char *key);
+
+void expression_cache_free(expression_cache **c);
+
+#endif //EXPRCACHE_H
@@ -0,0 +1,242 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <ctype.h>
+#include "expression.h"
+
+// constants for e and pi
+#ifndef M_E
+#define M_E 2.71828182845904523536
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// the longest number of a function
+#define LEX_NUMBER_SIZE 64
+
+/* ____________________________________________________________________________
+
+    static size_t scan_number(const char *text, size_t i)
+
+    Finds the end of a number, digits with an optional decimal point and
+    an optional exponent, a leading or trailing decimal point is allowed
+
+    Parameters:
+        text - The text
+        i - The position of the first digit or of the decimal point
+
+    Returns:
+        The position after the number, i if there is no digit
+   ____________________________________________________________________________
+*/
+static size_t scan_number(const char *text, size_t i) {
+
+    size_t start = i, digits = 0;
+    while(isdigit((unsigned char)text[i])) i++, digits++;
+    if(text[i] == '.') {
+        i++;
+        while(isdigit((unsigned char)text[i])) i++, digits++;
+    }
+    if(digits == 0) return start;
+
+    // an e followed by no exponent is the constant of the next token
+    if(text[i] == 'e' || text[i] == 'E') {
+        size_t exponent = i + 1;
+        if(text[exponent] == '+' || text[exponent] == '-') exponent++;
+        if(isdigit((unsigned char)text[exponent])) {
+            i = exponent;
+            while(isdigit((unsigned char)text[i])) i++;
+        }
+    }
+
+    return i;
+}
+
+/* ____________________________________________________________________________
+
+    int lex_expression(const char *text, queue_token *tokens, lex_error *error)
+
+    Splits a function into its tokens in one pass over the text. Only the
+    supported functions, the constants e and pi and the variable x are
+    names, the brackets have to be balanced.
+
+    Parameters:
+        text - The function as typed by the user
+        tokens - A queue receiving the tokens in the order of the text
+        error - A pointer receiving the position and the description of
+                an invalid text, the message is NULL when memory
+                allocation fails
+
+    Returns:
+        1 on success, 0 if the text is not a valid function
+   ____________________________________________________________________________
+*/
+int lex_expression(const char *text, queue_token *tokens, lex_error *error) {
+
+    // sanity check
+    if(!text || !tokens || !error) return 0;
+
+    int brackets = 0;
+    int operand = 0;    // the previous token ends an operand
+    size_t i = 0;
+
+    while(text[i] != '\0') {
+        char c = text[i];
+        if(isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+
+        token t;
+        t.type = TOKEN_NUMBER;
+        t.func = FUNC_SIN;
+        t.value = 0.0;
+        t.position = (uint)i;
+        error->position = (uint)i;
+
+        // numbers
+        if(isdigit((unsigned char)c) || c == '.') {
+            size_t end = scan_number(text, i);
+            char number[LEX_NUMBER_SIZE];
+            if(end == i || end - i >= LEX_NUMBER_SIZE) {
+                error->message = "an invalid number";
+                return 0;
+            }
+            memcpy(number, text + i, end - i);
+            number[end - i] = '\0';
+            t.value = strtod(number, NULL);
+            i = end;
+        }
+
+        // names of the variable, the constants and the functions
+        else if(c >= 'a' && c <= 'z') {
+            size_t start = i;
+            while(text[i] >= 'a' && text[i] <= 'z') i++;
+
+            size_t length = i - start;
+            if(length == 1 && c == 'x') {
+                t.type = TOKEN_X;
+            } else if(length == 1 && c == 'e') {
+                t.value = M_E;
+            } else if(length == 2 && memcmp(text + start, "pi", 2) == 0) {
+                t.value = M_PI;
+            } else {
+                int func = function_lookup(text + start, length);
+                if(func < 0) {
+                    error->message = "an unsupported function";
+                    return 0;
+                }
+                t.type = TOKEN_FUNCTION;
+                t.func = (function_id)func;
+            }
+        }
+
+        // operators and brackets, a minus without an operand before it
+        // is unary, ~ is an explicit unary minus
+        else {
+            switch(c) {
+                case '+': t.type = TOKEN_ADD; break;
+                case '-': t.type = operand ? TOKEN_SUB : TOKEN_NEG; break;
+                case '~': t.type = TOKEN_NEG; break;
+                case '*': t.type = TOKEN_MUL; break;
+                case '/': t.type = TOKEN_DIV; break;
+                case '^': t.type = TOKEN_POW; break;
+                case '(': t.type = TOKEN_OPEN; brackets++; break;
+                case ')':
+                    t.type = TOKEN_CLOSE;
+                    if(--brackets < 0) {
+                        error->message = "a closing bracket without an opening one";
+                        return 0;
+                    }
+                    break;
+                default:
+                    error->message = "an invalid character";
+                    return 0;
+            }
+            i++;
+        }
+
+        t.length = (uint)(i - t.position);
+        operand = t.type == TOKEN_NUMBER || t.type == TOKEN_X || t.type == TOKEN_CLOSE;
+        if(!queue_token_enqueue(tokens, t)) {
+            error->message = NULL;
+            return 0;
+        }
+    }
+
+    if(brackets > 0) {
+        error->position = (uint)i;
+        error->message = "an unclosed bracket";
+        return 0;
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    int tokens_contain_x(const queue_token *tokens)
+
+    Checks if a function depends on the variable x
+
+    Parameters:
+        tokens - The tokens of the function
+
+    Returns:
+        1 if a token is the variable x, 0 otherwise
+   ____________________________________________________________________________
+*/
+int tokens_contain_x(const queue_token *tokens) {
+
+    token t;
+    for(size_t i = 0; queue_token_get(tokens, i, &t); i++) {
+        if(t.type == TOKEN_X) return 1;
+    }
+
+    return 0;
+}
+
+/* ____________________________________________________________________________
+
+    char *format_tokens(const char *text, const queue_token *tokens, arena *scratch)
+
+    Writes the normalized form of a function, the tokens as they appear in
+    the text separated by single spaces. Functions differing only by their
+    spacing get the same form, which keys the caches of compiled functions
+    and of samples, and the form gives the same tokens when it is lexed.
+
+    Parameters:
+        text - The function the tokens were read from
+        tokens - The tokens of the function
+        scratch - The arena of the result or NULL for the heap
+
+    Returns:
+        The terminated normalized form or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+char *format_tokens(const char *text, const queue_token *tokens, arena *scratch) {
+
+    // sanity check
+    if(!text || !tokens) return NULL;
+
+    size_t size = 1;
+    token t;
+    for(size_t i = 0; queue_token_get(tokens, i, &t); i++) size += t.length + 1;
+
+    char *form = (char *)arena_alloc(scratch, size);
+    if(!form) return NULL;
+
+    size_t j = 0;
+    for(size_t i = 0; queue_token_get(tokens, i, &t); i++) {
+        if(j > 0) form[j++] = ' ';
+        memcpy(form + j, text + t.position, t.length);
+        j += t.length;
+    }
+    form[j] = '\0';
+
+    return form;
+}
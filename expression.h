@@ -0,0 +1,58 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include "arena.h"
+#include "functions.h"
+#include "queue.h"
+
+/* ____________________________________________________________________________
+
+    Lexical Analysis
+
+    The text of a function is split into typed tokens in a single pass.
+    Numbers and the constants e and pi carry their value, function names
+    their identifier, every token keeps its position in the text. A minus
+    is unary at the start, after an operator and after an open bracket.
+   ____________________________________________________________________________
+*/
+
+// kinds of the tokens
+typedef enum {
+    TOKEN_NUMBER,       // a number or a constant
+    TOKEN_X,
+    TOKEN_FUNCTION,
+    TOKEN_ADD, TOKEN_SUB, TOKEN_MUL, TOKEN_DIV, TOKEN_POW,
+    TOKEN_NEG,          // unary minus
+    TOKEN_OPEN, TOKEN_CLOSE
+} token_type;
+
+typedef struct {
+    token_type type;
+    function_id func;   // function of TOKEN_FUNCTION
+    double value;       // value of TOKEN_NUMBER
+    uint position;      // offset of the first character in the text
+    uint length;        // characters of the token in the text
+} token;
+
+// the tokens of a function in the order of the text or of its postfix form
+QUEUE_DEFINE(queue_token, token)
+
+// a text which is not a function
+typedef struct {
+    uint position;      // offset of the offending character
+    const char *message;
+} lex_error;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int lex_expression(const char *text, queue_token *tokens, lex_error *error);
+
+int tokens_contain_x(const queue_token *tokens);
+
+char *format_tokens(const char *text, const queue_token *tokens, arena *scratch);
+
+#endif //EXPRESSION_H
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "functions.h"
+#include "vecmath.h"
+
+// constants
+#define FUNCTION_PI 3.14159265358979323846
+#define FUNCTION_TWO_PI 6.28318530717958647693
+#define FUNCTION_HALF_PI 1.57079632679489661923
+#define LN10 2.30258509299404568402
+
+// block evaluation of the functions without a vector kernel, one tight
+// loop per function so the call is resolved at compile time
+#define BATCH_LOOP(name, f)                                                     \
+static void name(double *values, size_t n) {                                    \
+    for(size_t i = 0; i < n; i++) values[i] = f(values[i]);                     \
+}
+
+BATCH_LOOP(batch_asin, asin)
+BATCH_LOOP(batch_acos, acos)
+BATCH_LOOP(batch_atan, atan)
+BATCH_LOOP(batch_sinh, sinh)
+BATCH_LOOP(batch_cosh, cosh)
+BATCH_LOOP(batch_tanh, tanh)
+BATCH_LOOP(batch_abs, fabs)
+
+// derivatives of the functions, value is the function at x
+static double slope_sin(double x, double value) { (void)value; return cos(x); }
+static double slope_cos(double x, double value) { (void)value; return -sin(x); }
+static double slope_tan(double x, double value) { (void)x; return 1.0 + value * value; }
+static double slope_asin(double x, double value) { (void)value; return 1.0 / sqrt(1.0 - x * x); }
+static double slope_acos(double x, double value) { (void)value; return -1.0 / sqrt(1.0 - x * x); }
+static double slope_atan(double x, double value) { (void)value; return 1.0 / (1.0 + x * x); }
+static double slope_sinh(double x, double value) { (void)value; return cosh(x); }
+static double slope_cosh(double x, double value) { (void)value; return sinh(x); }
+static double slope_tanh(double x, double value) { (void)x; return 1.0 - value * value; }
+static double slope_log(double x, double value) { (void)value; return 1.0 / (x * LN10); }
+static double slope_ln(double x, double value) { (void)value; return 1.0 / x; }
+static double slope_sqrt(double x, double value) { (void)x; return 0.5 / value; }
+static double slope_abs(double x, double value) { (void)value; return x > 0.0 ? 1.0 : x < 0.0 ? -1.0 : 0.0; }
+static double slope_exp(double x, double value) { (void)x; return value; }
+
+const function_info function_table[FUNC_COUNT] = {
+    [FUNC_SIN]  = {"sin",  "sin",   sin,   vec_sin,    slope_sin,  SHAPE_PERIODIC,   -INFINITY, INFINITY, FUNCTION_HALF_PI, FUNCTION_TWO_PI},
+    [FUNC_COS]  = {"cos",  "cos",   cos,   vec_cos,    slope_cos,  SHAPE_PERIODIC,   -INFINITY, INFINITY, 0.0, FUNCTION_TWO_PI},
+    [FUNC_TAN]  = {"tan",  "tan",   tan,   vec_tan,    slope_tan,  SHAPE_POLES,      -INFINITY, INFINITY, FUNCTION_HALF_PI, FUNCTION_PI},
+    [FUNC_ASIN] = {"asin", "asin",  asin,  batch_asin, slope_asin, SHAPE_INCREASING, -1.0, 1.0, 0.0, 0.0},
+    [FUNC_ACOS] = {"acos", "acos",  acos,  batch_acos, slope_acos, SHAPE_DECREASING, -1.0, 1.0, 0.0, 0.0},
+    [FUNC_ATAN] = {"atan", "atan",  atan,  batch_atan, slope_atan, SHAPE_INCREASING, -INFINITY, INFINITY, 0.0, 0.0},
+    [FUNC_SINH] = {"sinh", "sinh",  sinh,  batch_sinh, slope_sinh, SHAPE_INCREASING, -INFINITY, INFINITY, 0.0, 0.0},
+    [FUNC_COSH] = {"cosh", "cosh",  cosh,  batch_cosh, slope_cosh, SHAPE_EVEN,       -INFINITY, INFINITY, 0.0, 0.0},
+    [FUNC_TANH] = {"tanh", "tanh",  tanh,  batch_tanh, slope_tanh, SHAPE_INCREASING, -INFINITY, INFINITY, 0.0, 0.0},
+    [FUNC_LOG]  = {"log",  "log10", log10, vec_log10,  slope_log,  SHAPE_INCREASING, 0.0, INFINITY, 0.0, 0.0},
+    [FUNC_LN]   = {"ln",   "log",   log,   vec_log,    slope_ln,   SHAPE_INCREASING, 0.0, INFINITY, 0.0, 0.0},
+    [FUNC_SQRT] = {"sqrt", "sqrt",  sqrt,  vec_sqrt,   slope_sqrt, SHAPE_INCREASING, 0.0, INFINITY, 0.0, 0.0},
+    [FUNC_ABS]  = {"abs",  "fabs",  fabs,  batch_abs,  slope_abs,  SHAPE_EVEN,       -INFINITY, INFINITY, 0.0, 0.0},
+    [FUNC_EXP]  = {"exp",  "exp",   exp,   vec_exp,    slope_exp,  SHAPE_INCREASING, -INFINITY, INFINITY, 0.0, 0.0}
+};
+
+/* ____________________________________________________________________________
+
+    int function_lookup(const char *name, size_t length)
+
+    Finds the function of a name in the registry. A switch on the length
+    and on the letter telling the names of that length apart picks the
+    only candidate, whose name in the table is compared once. The name is
+    resolved once when the function is read, the evaluation only uses the
+    identifier.
+
+    Parameters:
+        name - The name, not terminated
+        length - The number of letters of the name
+
+    Returns:
+        The function_id of the function or -1 if the function is unknown
+   ____________________________________________________________________________
+*/
+int function_lookup(const char *name, size_t length) {
+
+    // sanity check
+    if(!name) return -1;
+
+    int candidate = -1;
+    switch(length) {
+        case 2:
+            candidate = FUNC_LN;
+            break;
+
+        case 3:
+            switch(name[0]) {
+                case 's': candidate = FUNC_SIN; break;
+                case 'c': candidate = FUNC_COS; break;
+                case 't': candidate = FUNC_TAN; break;
+                case 'l': candidate = FUNC_LOG; break;
+                case 'a': candidate = FUNC_ABS; break;
+                case 'e': candidate = FUNC_EXP; break;
+            }
+            break;
+
+        case 4:
+            switch(name[1]) {
+                case 's': candidate = FUNC_ASIN; break;
+                case 'c': candidate = FUNC_ACOS; break;
+                case 't': candidate = FUNC_ATAN; break;
+                case 'q': candidate = FUNC_SQRT; break;
+                case 'i': candidate = FUNC_SINH; break;
+                case 'o': candidate = FUNC_COSH; break;
+                case 'a': candidate = FUNC_TANH; break;
+            }
+            break;
+    }
+
+    if(candidate < 0 || memcmp(function_table[candidate].name, name, length) != 0) return -1;
+
+    return candidate;
+}
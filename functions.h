@@ -0,0 +1,67 @@
+#ifndef FUNCTIONS_H
+#define FUNCTIONS_H
+
+#include <stddef.h>
+
+/* ____________________________________________________________________________
+
+    Function Registry
+
+    Every supported function is one row of function_table, indexed by its
+    function_id. The row holds everything the stages need: the name the
+    lexer recognizes, the name in the C library for the generated kernels,
+    the scalar and the block evaluation, the derivative of the dual number
+    evaluation and the shape of the function, from which the interval
+    evaluation encloses it. The evaluators dispatch by indexing the table,
+    names are only compared when a function is read.
+
+    A new function needs its identifier before FUNC_COUNT, its row at the
+    same position of the table and its case in the switch of
+    function_lookup.
+   ____________________________________________________________________________
+*/
+
+// identifiers of the supported functions
+typedef enum {
+    FUNC_SIN, FUNC_COS, FUNC_TAN,
+    FUNC_ASIN, FUNC_ACOS, FUNC_ATAN,
+    FUNC_SINH, FUNC_COSH, FUNC_TANH,
+    FUNC_LOG, FUNC_LN, FUNC_SQRT, FUNC_ABS,
+    FUNC_EXP,
+    FUNC_COUNT
+} function_id;
+
+// how the values of a function over an interval of arguments are bounded
+typedef enum {
+    SHAPE_INCREASING,   // monotonically increasing over the domain
+    SHAPE_DECREASING,   // monotonically decreasing over the domain
+    SHAPE_EVEN,         // even, growing away from zero
+    SHAPE_PERIODIC,     // between -1 and 1 with a maximum at phase
+    SHAPE_POLES         // increasing between poles at phase
+} function_shape;
+
+typedef struct {
+    const char *name;               // name in the functions of the user
+    const char *c_name;             // name in the C library
+    double (*scalar)(double x);
+    void (*batch)(double *values, size_t n);        // in place over a block
+    double (*derivative)(double x, double value);   // value is scalar(x)
+    function_shape shape;
+    double domain_lo;               // arguments outside the domain give NaN
+    double domain_hi;
+    double phase;                   // maximum or pole of the periodic shapes
+    double period;                  // period of the periodic shapes
+} function_info;
+
+// the registry, indexed by function_id
+extern const function_info function_table[FUNC_COUNT];
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int function_lookup(const char *name, size_t length);
+
+#endif //FUNCTIONS_H
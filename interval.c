@@ -0,0 +1,398 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "postfixmath.h"
+#include "interval.h"
+
+// constants
+#define INTERVAL_MARGIN 1e-12       // relative widening of every result
+#define INTERVAL_SLACK 1e-9         // relative slack of the extrema of periodic functions
+
+static const interval empty = {INFINITY, -INFINITY};
+static const interval whole = {-INFINITY, INFINITY};
+
+/* ____________________________________________________________________________
+
+    int interval_empty(interval a)
+
+    Checks if an interval contains no value
+
+    Parameters:
+        a - The interval
+
+    Returns:
+        1 if the interval is empty, 0 otherwise
+   ____________________________________________________________________________
+*/
+int interval_empty(interval a) {
+
+    return !(a.lo <= a.hi);
+}
+
+/* ____________________________________________________________________________
+
+    static interval make(double lo, double hi)
+
+    Creates the interval of a result, bounds which are NaN because of
+    infinite operands give the whole line
+
+    Parameters:
+        lo - The lower bound
+        hi - The upper bound
+
+    Returns:
+        The interval widened by the rounding margin
+   ____________________________________________________________________________
+*/
+static interval make(double lo, double hi) {
+
+    if(isnan(lo) || isnan(hi)) return whole;
+
+    double magnitude = fmax(isfinite(lo) ? fabs(lo) : 0.0, isfinite(hi) ? fabs(hi) : 0.0);
+    interval r = {lo - INTERVAL_MARGIN * magnitude, hi + INTERVAL_MARGIN * magnitude};
+
+    return r;
+}
+
+/* ____________________________________________________________________________
+
+    static int contains(interval a, double v)
+
+    Checks if an interval contains a value
+
+    Parameters:
+        a - The interval
+        v - The value
+
+    Returns:
+        1 if the value lies in the interval, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int contains(interval a, double v) {
+
+    return a.lo <= v && v <= a.hi;
+}
+
+/* ____________________________________________________________________________
+
+    static interval hull(interval a, double v)
+
+    Extends an interval by a value
+
+    Parameters:
+        a - The interval, it may be empty
+        v - The value
+
+    Returns:
+        The smallest interval containing both
+   ____________________________________________________________________________
+*/
+static interval hull(interval a, double v) {
+
+    if(interval_empty(a)) {
+        interval r = {v, v};
+        return r;
+    }
+
+    interval r = {fmin(a.lo, v), fmax(a.hi, v)};
+    return r;
+}
+
+/* ____________________________________________________________________________
+
+    static interval corners(double a, double b, double c, double d)
+
+    Creates the interval of four values, a NaN among them gives the whole
+    line
+
+    Parameters:
+        a, b, c, d - The values, for example the products of the bounds
+
+    Returns:
+        The interval from the smallest to the largest value
+   ____________________________________________________________________________
+*/
+static interval corners(double a, double b, double c, double d) {
+
+    if(isnan(a) || isnan(b) || isnan(c) || isnan(d)) return whole;
+
+    return make(fmin(fmin(a, b), fmin(c, d)), fmax(fmax(a, b), fmax(c, d)));
+}
+
+/* ____________________________________________________________________________
+
+    static interval multiply(interval a, interval b)
+
+    Multiplies two intervals
+
+    Parameters:
+        a, b - The factors
+
+    Returns:
+        The interval of the products
+   ____________________________________________________________________________
+*/
+static interval multiply(interval a, interval b) {
+
+    if(interval_empty(a) || interval_empty(b)) return empty;
+
+    return corners(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi);
+}
+
+/* ____________________________________________________________________________
+
+    static interval divide(interval a, interval b)
+
+    Divides two intervals, a divisor containing zero gives the whole line
+
+    Parameters:
+        a - The dividend
+        b - The divisor
+
+    Returns:
+        The interval of the quotients
+   ____________________________________________________________________________
+*/
+static interval divide(interval a, interval b) {
+
+    if(interval_empty(a) || interval_empty(b)) return empty;
+    if(contains(b, 0.0)) return whole;
+
+    return corners(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi);
+}
+
+/* ____________________________________________________________________________
+
+    static interval power(interval a, interval b)
+
+    Raises an interval to the power of another one. The bounds are exact
+    only for positive bases, pow(x, 0) and pow(1, y) are 1 even when the
+    other operand is NaN, so 1 joins the result when it is possible.
+
+    Parameters:
+        a - The base
+        b - The exponent
+
+    Returns:
+        The interval of the powers
+   ____________________________________________________________________________
+*/
+static interval power(interval a, interval b) {
+
+    interval r = empty;
+    if(!interval_empty(a) && !interval_empty(b)) {
+        if(a.lo <= 0.0) return whole;
+        r = corners(pow(a.lo, b.lo), pow(a.lo, b.hi), pow(a.hi, b.lo), pow(a.hi, b.hi));
+    }
+
+    // the operands may be NaN at points the intervals leave out
+    if(contains(b, 0.0) || contains(a, 1.0)) r = hull(r, 1.0);
+
+    return r;
+}
+
+/* ____________________________________________________________________________
+
+    static interval power_integer(interval a, int n)
+
+    Raises an interval to an integer power
+
+    Parameters:
+        a - The base
+        n - The exponent
+
+    Returns:
+        The interval of the powers
+   ____________________________________________________________________________
+*/
+static interval power_integer(interval a, int n) {
+
+    if(n == 0) return make(1.0, 1.0);
+    if(interval_empty(a)) return empty;
+
+    double lo = power_int(a.lo, n), hi = power_int(a.hi, n);
+
+    // a base reaching zero holds the pole of a negative exponent, an end
+    // at zero leaves the branch on the side of the base
+    if(n < 0 && a.lo <= 0.0 && a.hi >= 0.0) {
+        if(a.lo < 0.0 && a.hi > 0.0) return whole;
+        if(a.hi > 0.0) return make(power_int(a.hi, n), INFINITY);
+        if(a.lo < 0.0) return n % 2 == 0 ? make(lo, INFINITY) : make(-INFINITY, lo);
+        return whole;
+    }
+
+    // a base crossing zero is the minimum of an even exponent
+    if(a.lo < 0.0 && a.hi > 0.0 && n % 2 == 0) return make(0.0, fmax(lo, hi));
+
+    return corners(lo, hi, lo, hi);
+}
+
+/* ____________________________________________________________________________
+
+    static int reaches(interval a, double phase, double period)
+
+    Checks if an interval contains a point phase + k * period for some
+    integer k, points close to the ends are counted as contained
+
+    Parameters:
+        a - The interval
+        phase - The offset of the points
+        period - The distance of the points
+
+    Returns:
+        1 if such a point may lie in the interval, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int reaches(interval a, double phase, double period) {
+
+    double slack = INTERVAL_SLACK * (1.0 + fabs(a.lo) + fabs(a.hi)) / period;
+    double k = ceil((a.lo - phase) / period - slack);
+
+    return phase + k * period <= a.hi + slack * period;
+}
+
+/* ____________________________________________________________________________
+
+    static interval increasing(function_id func, interval a)
+
+    Applies a monotonically increasing function to an interval
+
+    Parameters:
+        func - The identifier of the function
+        a - The argument, inside the domain of the function
+
+    Returns:
+        The interval of the function values
+   ____________________________________________________________________________
+*/
+static interval increasing(function_id func, interval a) {
+
+    return make(evaluate_function(func, a.lo), evaluate_function(func, a.hi));
+}
+
+/* ____________________________________________________________________________
+
+    static interval enclose_function(function_id func, interval a)
+
+    Applies a supported function to an interval by the shape registered for
+    it, the argument is clipped to the domain of the function first
+
+    Parameters:
+        func - The identifier of the function
+        a - The argument
+
+    Returns:
+        The interval of the defined function values
+   ____________________________________________________________________________
+*/
+static interval enclose_function(function_id func, interval a) {
+
+    if(interval_empty(a)) return empty;
+    if((unsigned int)func >= FUNC_COUNT) return whole;
+
+    const function_info *f = &function_table[func];
+    if(a.hi < f->domain_lo || a.lo > f->domain_hi) return empty;
+    interval d = {fmax(a.lo, f->domain_lo), fmin(a.hi, f->domain_hi)};
+
+    switch(f->shape) {
+        case SHAPE_PERIODIC: {
+            if(!isfinite(d.lo) || !isfinite(d.hi) || d.hi - d.lo >= f->period) return make(-1.0, 1.0);
+
+            // the minima lie half a period after the maxima
+            double lo = f->scalar(d.lo), hi = f->scalar(d.hi);
+            interval r = {fmin(lo, hi), fmax(lo, hi)};
+            if(reaches(d, f->phase, f->period)) r.hi = 1.0;
+            if(reaches(d, f->phase - f->period / 2.0, f->period)) r.lo = -1.0;
+            return make(r.lo, r.hi);
+        }
+
+        case SHAPE_POLES:
+            if(!isfinite(d.lo) || !isfinite(d.hi) || d.hi - d.lo >= f->period) return whole;
+            if(reaches(d, f->phase, f->period)) return whole;
+            return increasing(func, d);
+
+        case SHAPE_DECREASING:
+            return make(f->scalar(d.hi), f->scalar(d.lo));
+
+        case SHAPE_EVEN: {
+            // even functions growing away from zero
+            double lo = f->scalar(d.lo), hi = f->scalar(d.hi);
+            if(d.lo < 0.0 && d.hi > 0.0) return make(f->scalar(0.0), fmax(lo, hi));
+            return make(fmin(lo, hi), fmax(lo, hi));
+        }
+
+        case SHAPE_INCREASING:
+            return increasing(func, d);
+
+        default:
+            return whole;
+    }
+}
+
+/* ____________________________________________________________________________
+
+    int program_enclose(const program *p, double x_lo, double x_hi,
+                        interval *stack, interval *y)
+
+    Evaluates a program over a range of x by interval arithmetic. The
+    result contains every defined value of the program over the range and
+    may be wider.
+
+    Parameters:
+        p - A pointer to the compiled program
+        x_lo - The start of the range
+        x_hi - The end of the range
+        stack - The working memory of p->depth + p->slots intervals, it is
+                reused by the calls for the ranges of a program
+        y - A pointer receiving the interval of the values
+
+    Returns:
+        1 on success, 0 if invalid parameters are provided
+   ____________________________________________________________________________
+*/
+int program_enclose(const program *p, double x_lo, double x_hi, interval *stack, interval *y) {
+
+    // sanity check
+    if(!p || !stack || !y || !(x_lo <= x_hi) || p->depth == 0) return 0;
+
+    // the value stack followed by the shared values
+    interval *s = stack;
+    interval *slots = s + p->depth;
+    int sp = -1;
+
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+        switch(in->op) {
+            case OP_CONST: sp++; s[sp].lo = in->value; s[sp].hi = in->value; break;
+            case OP_X: sp++; s[sp].lo = x_lo; s[sp].hi = x_hi; break;
+            case OP_ADD:
+                sp--;
+                s[sp] = interval_empty(s[sp]) || interval_empty(s[sp + 1]) ? empty :
+                        make(s[sp].lo + s[sp + 1].lo, s[sp].hi + s[sp + 1].hi);
+                break;
+            case OP_SUB:
+                sp--;
+                s[sp] = interval_empty(s[sp]) || interval_empty(s[sp + 1]) ? empty :
+                        make(s[sp].lo - s[sp + 1].hi, s[sp].hi - s[sp + 1].lo);
+                break;
+            case OP_MUL: sp--; s[sp] = multiply(s[sp], s[sp + 1]); break;
+            case OP_DIV: sp--; s[sp] = divide(s[sp], s[sp + 1]); break;
+            case OP_POW: sp--; s[sp] = power(s[sp], s[sp + 1]); break;
+            case OP_NEG:
+                if(!interval_empty(s[sp])) {
+                    double lo = s[sp].lo;
+                    s[sp].lo = -s[sp].hi;
+                    s[sp].hi = -lo;
+                }
+                break;
+            case OP_FUNC: s[sp] = enclose_function(in->func, s[sp]); break;
+            case OP_POWI: s[sp] = power_integer(s[sp], (int)in->value); break;
+            case OP_STORE: slots[(uint)in->value] = s[sp]; break;
+            case OP_LOAD: s[++sp] = slots[(uint)in->value]; break;
+        }
+    }
+
+    *y = s[0];
+
+    return 1;
+}
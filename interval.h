@@ -0,0 +1,34 @@
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "postfixmath.h"
+
+/* ____________________________________________________________________________
+
+    Interval Evaluation
+
+    Bounds a program over a whole range of x. The interval of a value
+    encloses all its defined values over the range, points where the value
+    is NaN are left out, so an empty interval means the value is undefined
+    over the whole range. Every bound is widened slightly to cover the
+    rounding of all evaluation backends.
+   ____________________________________________________________________________
+*/
+
+// the values lo up to hi, empty when lo > hi
+typedef struct {
+    double lo;
+    double hi;
+} interval;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int interval_empty(interval a);
+
+int program_enclose(const program *p, double x_lo, double x_hi, interval *stack, interval *y);
+
+#endif //INTERVAL_H
@@ -0,0 +1,360 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "postfixmath.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// constants
+#define JIT_MAX_INSTRUCTION 32
+#define JIT_PROLOGUE_SIZE 64
+
+#ifdef JIT_X86_64
+
+// buffer receiving the machine code
+typedef struct {
+    unsigned char *code;
+    size_t length;
+} assembler;
+
+/* ____________________________________________________________________________
+
+    Emitting of the machine code
+
+    The value stack lives in the stack frame, slot i at [rbp - 16 - 8 * i],
+    the shared values follow the stack, the argument x is kept at [rbp - 8]. xmm0 and xmm1 are the only
+    registers used, so nothing has to be saved around function calls.
+   ____________________________________________________________________________
+*/
+static void emit_bytes(assembler *a, const unsigned char *bytes, size_t n) {
+
+    memcpy(a->code + a->length, bytes, n);
+    a->length += n;
+}
+
+static void emit_u32(assembler *a, uint32_t value) {
+
+    emit_bytes(a, (const unsigned char *)&value, 4);
+}
+
+static void emit_u64(assembler *a, uint64_t value) {
+
+    emit_bytes(a, (const unsigned char *)&value, 8);
+}
+
+static int32_t slot(uint i) {
+
+    return -16 - 8 * (int32_t)i;
+}
+
+// op xmm(reg), [rbp + disp32] with a prefix and an opcode such as movsd
+static void emit_memory(assembler *a, unsigned char prefix, unsigned char opcode, int reg, int32_t disp) {
+
+    unsigned char bytes[4] = {prefix, 0x0f, opcode, (unsigned char)(0x85 | (reg << 3))};
+    emit_bytes(a, bytes, 4);
+    emit_u32(a, (uint32_t)disp);
+}
+
+static void emit_load(assembler *a, int reg, int32_t disp) {
+
+    emit_memory(a, 0xf2, 0x10, reg, disp);     // movsd xmm, [rbp + disp]
+}
+
+static void emit_store(assembler *a, int reg, int32_t disp) {
+
+    emit_memory(a, 0xf2, 0x11, reg, disp);     // movsd [rbp + disp], xmm
+}
+
+// movabs rax, imm64
+static void emit_mov_rax(assembler *a, uint64_t value) {
+
+    const unsigned char bytes[2] = {0x48, 0xb8};
+    emit_bytes(a, bytes, 2);
+    emit_u64(a, value);
+}
+
+// movq xmm(reg), rax
+static void emit_movq_from_rax(assembler *a, int reg) {
+
+    const unsigned char bytes[5] = {0x66, 0x48, 0x0f, 0x6e, (unsigned char)(0xc0 | (reg << 3))};
+    emit_bytes(a, bytes, 5);
+}
+
+// loads a double constant into a register through rax
+static void emit_constant(assembler *a, int reg, double value) {
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    emit_mov_rax(a, bits);
+    emit_movq_from_rax(a, reg);
+}
+
+// op xmm(dst), xmm(src) for the scalar double operations
+static void emit_register(assembler *a, unsigned char prefix, unsigned char opcode, int dst, int src) {
+
+    const unsigned char bytes[4] = {prefix, 0x0f, opcode, (unsigned char)(0xc0 | (dst << 3) | src)};
+    emit_bytes(a, bytes, 4);
+}
+
+// mov rax, function; call rax
+static void emit_call(assembler *a, void (*function)(void)) {
+
+    uint64_t address;
+    memcpy(&address, &function, sizeof(address));
+    emit_mov_rax(a, address);
+
+    const unsigned char bytes[2] = {0xff, 0xd0};
+    emit_bytes(a, bytes, 2);
+}
+
+/* ____________________________________________________________________________
+
+    static void (*function_address(function_id func))(void)
+
+    Returns the scalar implementation of a function of the program from
+    the function registry
+
+    Parameters:
+        func - The identifier of the function
+
+    Returns:
+        The address of the function, NULL for an unknown function
+   ____________________________________________________________________________
+*/
+static void (*function_address(function_id func))(void) {
+
+    if((unsigned int)func >= FUNC_COUNT) return NULL;
+
+    return (void (*)(void))function_table[func].scalar;
+}
+
+/* ____________________________________________________________________________
+
+    static void emit_power_int(assembler *a, int exponent)
+
+    Raises xmm0 to an integer power by an unrolled chain of multiplications,
+    the result is left in xmm0
+
+    Parameters:
+        a - A pointer to the assembler
+        exponent - The integer exponent
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void emit_power_int(assembler *a, int exponent) {
+
+    unsigned int n = exponent < 0 ? -(unsigned int)exponent : (unsigned int)exponent;
+
+    // xmm1 = 1, then square and multiply like power_int
+    emit_constant(a, 1, 1.0);
+    while(n > 0) {
+        if(n & 1) emit_register(a, 0xf2, 0x59, 1, 0);      // mulsd xmm1, xmm0
+        n >>= 1;
+        if(n > 0) emit_register(a, 0xf2, 0x59, 0, 0);      // mulsd xmm0, xmm0
+    }
+
+    if(exponent < 0) {
+        emit_constant(a, 0, 1.0);
+        emit_register(a, 0xf2, 0x5e, 0, 1);                // divsd xmm0, xmm1
+    } else {
+        emit_register(a, 0xf2, 0x10, 0, 1);                // movsd xmm0, xmm1
+    }
+}
+
+/* ____________________________________________________________________________
+
+    static void emit_program(assembler *a, const program *p)
+
+    Translates the instructions of a program into machine code
+
+    Parameters:
+        a - A pointer to the assembler with enough space
+        p - A pointer to the compiled program
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void emit_program(assembler *a, const program *p) {
+
+    // push rbp; mov rbp, rsp; sub rsp, frame, keeps rsp aligned for calls
+    uint32_t frame = (8 * (p->depth + p->slots + 2) + 15) & ~15u;
+    const unsigned char prologue[7] = {0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec};
+    emit_bytes(a, prologue, 7);
+    emit_u32(a, frame);
+    emit_store(a, 0, -8);
+
+    int sp = -1;
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+
+        switch(in->op) {
+            case OP_CONST:
+                emit_constant(a, 0, in->value);
+                emit_store(a, 0, slot(++sp));
+                break;
+
+            case OP_X:
+                emit_load(a, 0, -8);
+                emit_store(a, 0, slot(++sp));
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV: {
+                // addsd, subsd, mulsd or divsd xmm0, [second operand]
+                unsigned char opcode = in->op == OP_ADD ? 0x58 : in->op == OP_SUB ? 0x5c :
+                                       in->op == OP_MUL ? 0x59 : 0x5e;
+                emit_load(a, 0, slot(sp - 1));
+                emit_memory(a, 0xf2, opcode, 0, slot(sp));
+                emit_store(a, 0, slot(--sp));
+                break;
+            }
+
+            case OP_POW:
+                emit_load(a, 0, slot(sp - 1));
+                emit_load(a, 1, slot(sp));
+                emit_call(a, (void (*)(void))pow);
+                emit_store(a, 0, slot(--sp));
+                break;
+
+            case OP_NEG:
+                // flip the sign bit
+                emit_load(a, 0, slot(sp));
+                emit_mov_rax(a, 0x8000000000000000ULL);
+                emit_movq_from_rax(a, 1);
+                emit_register(a, 0x66, 0x57, 0, 1);        // xorpd xmm0, xmm1
+                emit_store(a, 0, slot(sp));
+                break;
+
+            case OP_FUNC:
+                emit_load(a, 0, slot(sp));
+                if(in->func == FUNC_SQRT) {
+                    emit_register(a, 0xf2, 0x51, 0, 0);    // sqrtsd xmm0, xmm0
+                } else if(in->func == FUNC_ABS) {
+                    emit_mov_rax(a, 0x7fffffffffffffffULL);
+                    emit_movq_from_rax(a, 1);
+                    emit_register(a, 0x66, 0x54, 0, 1);    // andpd xmm0, xmm1
+                } else {
+                    emit_call(a, function_address(in->func));
+                }
+                emit_store(a, 0, slot(sp));
+                break;
+
+            case OP_POWI:
+                emit_load(a, 0, slot(sp));
+                emit_power_int(a, (int)in->value);
+                emit_store(a, 0, slot(sp));
+                break;
+
+            case OP_STORE:
+                emit_load(a, 0, slot(sp));
+                emit_store(a, 0, slot(p->depth + (uint)in->value));
+                break;
+
+            case OP_LOAD:
+                emit_load(a, 0, slot(p->depth + (uint)in->value));
+                emit_store(a, 0, slot(++sp));
+                break;
+        }
+    }
+
+    // movsd xmm0, [result]; leave; ret
+    emit_load(a, 0, slot(0));
+    const unsigned char epilogue[2] = {0xc9, 0xc3};
+    emit_bytes(a, epilogue, 2);
+}
+
+#endif // JIT_X86_64
+
+/* ____________________________________________________________________________
+
+    jit_program *jit_compile(const program *p)
+
+    Translates a compiled program into native code. The code is written
+    into a writable mapping which is made executable and read only
+    afterwards.
+
+    Parameters:
+        p - A pointer to the compiled program
+
+    Returns:
+        A pointer to the native program or NULL if the platform is not
+        supported or the memory cannot be mapped
+   ____________________________________________________________________________
+*/
+jit_program *jit_compile(const program *p) {
+
+    // sanity check
+    if(!p || !p->code || p->length == 0) return NULL;
+
+#ifdef JIT_X86_64
+    // the longest instruction is a function call with its loads and stores
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = JIT_PROLOGUE_SIZE + (size_t)p->length * JIT_MAX_INSTRUCTION * 4;
+    if(page > 0) size = (size + (size_t)page - 1) / (size_t)page * (size_t)page;
+
+    jit_program *j = (jit_program *)malloc(sizeof(jit_program));
+    if(!j) return NULL;
+
+    void *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(code == MAP_FAILED) {
+        free(j);
+        return NULL;
+    }
+
+    assembler a = {(unsigned char *)code, 0};
+    emit_program(&a, p);
+
+    // switch the mapping from writable to executable
+    if(mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, size);
+        free(j);
+        return NULL;
+    }
+
+    j->code = code;
+    j->size = size;
+    memcpy(&j->function, &code, sizeof(j->function));
+
+    return j;
+#else
+    return NULL;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    void jit_free(jit_program **j)
+
+    Unmaps the native code and frees the native program
+
+    Parameters:
+        j - A double pointer to the native program to be freed
+
+    Returns:
+        Nothing. The pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void jit_free(jit_program **j) {
+
+    // sanity check
+    if(!j || !*j) return;
+
+#ifdef JIT_X86_64
+    munmap((*j)->code, (*j)->size);
+#endif
+    free(*j);
+    *j = NULL;
+}
@@ -0,0 +1,37 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "postfixmath.h"
+
+/* ____________________________________________________________________________
+
+    Native Code of a Program
+
+    The x86-64 backend translates a compiled program into machine code,
+    arithmetic runs in SSE2 registers and functions are called directly.
+    The code is written into an anonymous mapping which is never writable
+    and executable at the same time. On other platforms jit_compile
+    returns NULL and the interpreter is used.
+   ____________________________________________________________________________
+*/
+
+typedef double (*native_function)(double);
+
+typedef struct {
+    void *code;
+    size_t size;
+    native_function function;
+} jit_program;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+jit_program *jit_compile(const program *p);
+
+void jit_free(jit_program **j);
+
+#endif //JIT_H
@@ -1,262 +1,200 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#define _USE_MATH_DEFINES
-#include <math.h>
-#include <ctype.h>
-#include "postscript.h"
-
-// constants for e and pi
-#ifndef M_E
-#define M_E 2.71828182845904523536
+#ifndef _WIN32
+#include <pthread.h>
 #endif
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
+#include "daemon.h"
+#include "render.h"
+#include "sampler.h"
+#include "stats.h"
+
+// initial size of the buffer of the job file
+#define JOB_FILE_INITIAL_SIZE 4096
+
+// the jobs shared by the workers of the pool
+typedef struct {
+    job *jobs;
+    size_t count;
+    size_t next;        // the first job not taken by a worker
+    const render_options *options;
+#ifndef _WIN32
+    pthread_mutex_t lock;
 #endif
-
-// constants for return
-#define SUCCESS 0
-#define ERR_INVALID_ARGUMENTS 1
-#define ERR_INVALID_FUNCTION 2
-#define ERR_FILE_ERROR 3
-#define ERR_INVALID_LIMITS 4
+} job_queue;
 
 /* ____________________________________________________________________________
 
-    char *add_spaces(const char *expression)
+    void *job_worker(void *argument)
 
-    Processes a mathematical expression string:
-    - Adds spaces around operators and parentheses
-    - Replaces constants e or pi with their numerical values
-    - Converts exp(x) to e ^ x
+    Renders the jobs of the queue until no job is left, the renders of a
+    worker reuse one arena
 
     Parameters:
-        expression - mathematical expression string
+        argument - A pointer to the job_queue
 
     Returns:
-        a new string with the processed expression
+        NULL
    ____________________________________________________________________________
 */
-char *add_spaces(const char *expression) {
-
-    // sanity check
-    if(expression == NULL) return NULL;
-
-    // allocate memory for the processed string
-    size_t length = strlen(expression);
-    char *result = (char *)malloc(4 * length + 1);
-    if(!result) exit(EXIT_FAILURE);
-
-
-    size_t j = 0;
-    for(size_t i = 0; i < length; i++) {
-        char current = expression[i];
-
-        // handling exp
-        if(current == 'e' && i + 3 < length &&
-            expression[i + 1] == 'x' &&
-            expression[i + 2] == 'p' &&
-            expression[i + 3] == '(') {
-            // adding constant e
-            char e_str[32];
-            sprintf(e_str, "%.15g", M_E); // converting to string
-            for(size_t k = 0; k < strlen(e_str); k++) {
-                result[j++] = e_str[k];
-            }
-            if(j > 0 && result[j - 1] != ' ') result[j++] = ' ';
-
-            // adding ^
-            result[j++] = '^';
-            result[j++] = ' ';
-
-            // skipping exp(
-            i += 3;
-
-            // adding content in brackets
-            size_t paren_depth = 1;
-            while(paren_depth > 0 && ++i < length) {
-                current = expression[i];
-                if(current == '(') paren_depth++;
-                if(current == ')') paren_depth--;
-                if(paren_depth > 0) {
-                    result[j++] = current;
-                }
-            }
-			if(current == ')') result[j++] = ' ';
-            continue;
-        }
+static void *job_worker(void *argument) {
 
-        // replace negative signs with ~ for unary negation
-        if(current == '-' &&
-    		(i == 0 || (!isdigit(expression[i - 1]) && expression[i - 1] != ')')) && // check previous character
-    		(i + 1 < length &&
-     			(expression[i + 1] == '(' ||
-      			isalpha(expression[i + 1]) ||
-      			isdigit(expression[i + 1])))) { // check next character
-    		if(j > 0 && result[j - 1] != ' ') result[j++] = ' ';
-            result[j++] = '~';
-            result[j++] = ' ';
+    job_queue *q = (job_queue *)argument;
+    render_options options = *q->options;
+    options.scratch = arena_create(0);
 
-        }
+    for(;;) {
+#ifndef _WIN32
+        pthread_mutex_lock(&q->lock);
+#endif
+        size_t i = q->next < q->count ? q->next++ : q->count;
+#ifndef _WIN32
+        pthread_mutex_unlock(&q->lock);
+#endif
+        if(i == q->count) break;
 
-		// replace e with Euler's number
-        else if(current == 'e' &&
-                 (i == 0 || !isalpha(expression[i - 1])) && // checks if the letter is not part any function
-                 (i + 1 == length || !isalpha(expression[i + 1]))) {
-            char e_str[32];
-            sprintf(e_str, "%.15g", M_E); // convert to string
-            for(size_t k = 0; k < strlen(e_str); k++) {
-                result[j++] = e_str[k];
-            }
+        job *j = &q->jobs[i];
+        if(j->status == SUCCESS) {
+            j->status = render_graph(j->functions, j->outfile, NULL, j->limits, &options, j->error);
         }
+    }
 
-        // replace pi with Pi's value
-        else if(current == 'p' && i + 1 < length && expression[i + 1] == 'i' &&
-                 (i == 0 || !isalpha(expression[i - 1])) && // checks if the letter is not part any function
-                 (i + 2 == length || !isalpha(expression[i + 2]))) {
-            char pi_str[32];
-            sprintf(pi_str, "%.15g", M_PI); // convert to string
-            for(size_t k = 0; k < strlen(pi_str); k++) {
-                result[j++] = pi_str[k];
-            }
-            i++; // skipping next char
-        }
+    arena_free(&options.scratch);
 
-        // add spaces around operators
-        else if(current == '+' || current == '-' || current == '*' || current == '/' || current == '^') {
-            if(j > 0 && result[j - 1] != ' ') result[j++] = ' ';
-            result[j++] = current;
-            if(expression[i + 1] != ' ') result[j++] = ' ';
-        }
+    return NULL;
+}
 
-        // add space after function names before open bracket
-        else if(isalpha(current)) {
-            result[j++] = current;
-            if(i + 1 < length && expression[i + 1] == '(') {
-                result[j++] = ' ';
-            }
-        }
+/* ____________________________________________________________________________
 
-        // handling open bracket
-        else if(current == '(') {
-            result[j++] = current;
-            if(expression[i + 1] != ' ') result[j++] = ' ';
-        }
+    char *read_job_file(const char *filename)
 
-        // handling close bracket
-        else if(current == ')') {
-            if(j > 0 && result[j - 1] != ' ') result[j++] = ' ';
-            result[j++] = current;
-        }
+    Reads the whole job file into memory
 
-        // handle leading decimal points
-        else if(current == '.' && (i == 0 || !isdigit(expression[i - 1]))) {
-            result[j++] = '0'; // add 0 before alone decimal point
-            result[j++] = current;
-        }
-		// copy other characters unchanged
-        else {
-            result[j++] = current;
-        }
+    Parameters:
+        filename - The name of the job file
+
+    Returns:
+        The terminated content of the file or NULL if it cannot be read
+   ____________________________________________________________________________
+*/
+char *read_job_file(const char *filename) {
+
+    FILE *f = fopen(filename, "rb");
+    if(!f) return NULL;
+
+    size_t size = 0, capacity = JOB_FILE_INITIAL_SIZE;
+    char *content = (char *)malloc(capacity);
+    while(content) {
+        size += fread(content + size, 1, capacity - size - 1, f);
+        if(size < capacity - 1) break;
+
+        capacity *= 2;
+        char *larger = (char *)realloc(content, capacity);
+        if(!larger) free(content);
+        content = larger;
     }
-    // terminate the string
-    result[j] = '\0';
 
-    return result;
+    if(content && ferror(f)) {
+        free(content);
+        content = NULL;
+    }
+    fclose(f);
+    if(content) content[size] = '\0';
+
+    return content;
 }
 
 /* ____________________________________________________________________________
 
-    int is_valid_function(const char *func)
+    int run_jobs(const char *filename, const render_options *o, int workers)
 
-    Validates a mathematical function string
+    Renders every graph of a job file in one process by a pool of threads
+    and prints the status of every job in the order of the file
 
     Parameters:
-        func - The mathematical function string to validate
+        filename - The job file, every line is <func> <out-file> [<limits>]
+        o - The options of the rendering, the threads are split among the jobs
+        workers - The number of threads of the pool
 
     Returns:
-        1 if the function is valid, 0 otherwise
+        SUCCESS (0) if every graph is generated successfully
+        ERR_FILE_ERROR if the job file cannot be read
+        Otherwise the error code of the first failed job
    ____________________________________________________________________________
 */
-int is_valid_function(const char *func) {
-
-    // sanity check
-    if(func == NULL) return 0;
-
-    // allowed chars
-    const char *allowed_chars = "0123456789+-*/^~().xE";
+int run_jobs(const char *filename, const render_options *o, int workers) {
 
-    // allowed functions
-    const char *allowed_functions[] = {"sin", "cos", "tan",
-                                       "asin", "acos", "atan",
-                                       "sinh", "cosh", "tanh",
-                                       "log", "ln", "sqrt", "abs", NULL};
-
-    // bracket counter
-    int bracket_count = 0;
-
-    // iterate through string
-    size_t i = 0;
-    while(func[i] != '\0') {
-        char c = func[i];
+    char *content = read_job_file(filename);
+    if(!content) {
+        fprintf(stderr, "Error: Failed to read the job file %s\n", filename);
+        return ERR_FILE_ERROR;
+    }
 
-        // ignore spaces
-        if(isspace(c)) {
-            i++;
-            continue;
-        }
+    // one job per line at most
+    size_t lines = 1;
+    for(const char *c = content; *c; c++) lines += *c == '\n';
+    job *jobs = (job *)malloc(sizeof(job) * lines);
+    if(!jobs) {
+        free(content);
+        fprintf(stderr, "Error: Out of memory.\n");
+        return ERR_FILE_ERROR;
+    }
 
-        // check individual characters
-        if(!strchr(allowed_chars, c)) {
-            // check if the character is a valid function name
-            if(isalpha(c)) {
-                int valid_function = 0;
-                for(int j = 0; allowed_functions[j] != NULL; j++) {
-                    size_t len = strlen(allowed_functions[j]);
-                    // check if the function matches and is followed by '(' or space
-                    if(strncmp(&func[i], allowed_functions[j], len) == 0 &&
-                        (func[i + len] == '(' || isspace(func[i + len]) || func[i + len] == '\0')) {
-                        valid_function = 1;
-                        i += len - 1;
-                        break;
-                    }
-                }
-
-                if(!valid_function) {
-                    return 0; // invalid function
-                }
-            } else {
-                return 0; // invalid character
-            }
-        }
+    size_t count = 0;
+    char *line = content;
+    for(int number = 1; line; number++) {
+        char *next = strchr(line, '\n');
+        if(next) *next++ = '\0';
+        if(parse_job(line, &jobs[count])) jobs[count++].line = number;
+        line = next;
+    }
 
-        // count open brackets
-        if(c == '(') {
-            bracket_count++;
-        }
+    // the threads of the pool sample their graphs alone unless jobs are few
+    job_queue q;
+    render_options job_options = *o;
+    if(workers > (int)count) workers = count > 0 ? (int)count : 1;
+    job_options.threads = o->threads / workers > 1 ? o->threads / workers : 1;
+    q.jobs = jobs;
+    q.count = count;
+    q.next = 0;
+    q.options = &job_options;
+
+#ifndef _WIN32
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * workers);
+    int started = 0;
+    while(ids && started < workers && pthread_create(&ids[started], NULL, job_worker, &q) == 0) started++;
+
+    // the main thread finishes the queue alone if no thread starts
+    if(started == 0) job_worker(&q);
+    for(int i = 0; i < started; i++) pthread_join(ids[i], NULL);
+    free(ids);
+    pthread_mutex_destroy(&q.lock);
+#else
+    job_worker(&q);
+#endif
 
-        // count close brackets
-        if(c == ')') {
-            bracket_count--;
-            // check if closing bracket appears before an opening bracket
-            if(bracket_count < 0) {
-                return 0;
-            }
+    // report the jobs in the order of the file
+    int result = SUCCESS;
+    size_t failed = 0;
+    for(size_t i = 0; i < count; i++) {
+        const job *j = &jobs[i];
+        if(j->status == SUCCESS) {
+            printf("Job %d: %s %d OK\n", j->line, j->outfile, j->status);
+        } else {
+            printf("Job %d: %s %d Error: %s\n", j->line, j->outfile ? j->outfile : "-", j->status, j->error);
+            if(result == SUCCESS) result = j->status;
+            failed++;
         }
-
-        i++;
     }
+    printf("Jobs: %zu rendered, %zu failed\n", count - failed, failed);
 
-    // check if all open brackets are closed
-    if(bracket_count != 0) {
-        return 0;
-    }
+    free(jobs);
+    free(content);
 
-    return 1;
+    return result;
 }
 
-
 /* ____________________________________________________________________________
 
     int main(int argc, char *argv[])
@@ -267,9 +205,33 @@ int is_valid_function(const char *func) {
     Parameters:
         argc - The number of command-line arguments
         argv - Array of command-line arguments:
-               argv[1] - Mathematical function as a string
+               argv[1] - Mathematical functions as a string separated by ';', each
+                         optionally followed by its color as @rrggbb
                argv[2] - Output file name for the PostScript file
                argv[3] (optional) - Limits for the graph in the format x_min:x_max:y_min:y_max
+               --simplify=<tolerance> (optional) - Simplifies the path of the graph,
+                                                   tolerance in PostScript units
+               --threads=<count> (optional) - Number of threads sampling the graph
+               --dump (optional) - Prints the optimized program of the function
+               --backend=<interpreter|jit|c> (optional) - Evaluation of the function,
+                                                         jit translates it into native code,
+                                                         c compiles a cached C kernel by gcc
+               --sampler=<subdivision|derivative> (optional) - Sampling of the functions, derivative
+                                                              chooses the steps by the derivative
+               --derivative (optional) - Draws the derivatives of the functions below them
+               --stats (optional) - Prints the time of every phase and counters of the render
+               --trace=<file> (optional) - Writes the phases as Chrome trace events
+               --tiles=<directory> (optional) - Keeps the samples of the functions in
+                                                memory-mapped files of the directory
+               --export=<file|shm:name> (optional) - Writes the samples of the functions as
+                                                     binary x, y pairs with flags into a file
+                                                     or a POSIX shared memory segment
+               --export-type=<float64|float32> (optional) - Type of the exported values
+               --jobs=<file> (optional) - Renders every line <func> <out-file> [<limits>]
+                                          of the file instead of the arguments, by a pool
+                                          of --threads workers
+               --daemon=<socket> (optional) - Serves the same lines sent to a Unix domain
+                                              socket, the out-file - returns the graph
 
     Returns:
         SUCCESS (0) if the graph is generated successfully
@@ -278,79 +240,120 @@ int is_valid_function(const char *func) {
 */
 int main(int argc, char *argv[]) {
 
-    // check the number of arguments
-    if(argc < 3) {
-        printf("Error: Missing arguments\nCode needs all these arguments: graph.exe <func> <out-file> [<limits>]\n");
-        return ERR_INVALID_ARGUMENTS;
+    // options of the rendering
+    render_options o;
+    o.tolerance = 0.0;
+    o.threads = sampler_default_threads();
+    o.dump = 0;
+    o.evaluation = BACKEND_INTERPRETER;
+    o.verbose = 1;
+    o.cache = NULL;
+    o.tiles = NULL;
+    o.export_target = NULL;
+    o.export_precision = EXPORT_FLOAT64;
+    o.derivative_steps = 0;
+    o.draw_slopes = 0;
+    o.scratch = NULL;
+    int statistics = 0;
+    const char *trace = NULL;
+    const char *jobs = NULL;
+    const char *socket_path = NULL;
+
+    // split the options from the positional arguments
+    char *arguments[3] = {NULL, NULL, NULL};
+    int argument_count = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--simplify=", 11) == 0) {
+            if(sscanf(argv[i] + 11, "%lf", &o.tolerance) != 1 || o.tolerance < 0.0) {
+                printf("Error: Invalid tolerance of the simplification.\n");
+                return ERR_INVALID_ARGUMENTS;
+            }
+        } else if(strncmp(argv[i], "--threads=", 10) == 0) {
+            if(sscanf(argv[i] + 10, "%d", &o.threads) != 1 || o.threads < 1) {
+                printf("Error: Invalid number of threads.\n");
+                return ERR_INVALID_ARGUMENTS;
+            }
+        } else if(strcmp(argv[i], "--dump") == 0) {
+            o.dump = 1;
+        } else if(strcmp(argv[i], "--backend=interpreter") == 0) {
+            o.evaluation = BACKEND_INTERPRETER;
+        } else if(strcmp(argv[i], "--backend=jit") == 0) {
+            o.evaluation = BACKEND_JIT;
+        } else if(strcmp(argv[i], "--backend=c") == 0) {
+            o.evaluation = BACKEND_C;
+        } else if(strcmp(argv[i], "--sampler=subdivision") == 0) {
+            o.derivative_steps = 0;
+        } else if(strcmp(argv[i], "--sampler=derivative") == 0) {
+            o.derivative_steps = 1;
+        } else if(strcmp(argv[i], "--derivative") == 0) {
+            o.draw_slopes = 1;
+        } else if(strcmp(argv[i], "--stats") == 0) {
+            statistics = 1;
+        } else if(strncmp(argv[i], "--trace=", 8) == 0 && argv[i][8] != '\0') {
+            trace = argv[i] + 8;
+        } else if(strncmp(argv[i], "--tiles=", 8) == 0 && argv[i][8] != '\0') {
+            o.tiles = argv[i] + 8;
+        } else if(strncmp(argv[i], "--export=", 9) == 0 && argv[i][9] != '\0') {
+            o.export_target = argv[i] + 9;
+        } else if(strcmp(argv[i], "--export-type=float64") == 0) {
+            o.export_precision = EXPORT_FLOAT64;
+        } else if(strcmp(argv[i], "--export-type=float32") == 0) {
+            o.export_precision = EXPORT_FLOAT32;
+        } else if(strncmp(argv[i], "--jobs=", 7) == 0 && argv[i][7] != '\0') {
+            jobs = argv[i] + 7;
+        } else if(strncmp(argv[i], "--daemon=", 9) == 0 && argv[i][9] != '\0') {
+            socket_path = argv[i] + 9;
+        } else if(strncmp(argv[i], "--", 2) == 0) {
+            printf("Error: Unknown option %s\n", argv[i]);
+            return ERR_INVALID_ARGUMENTS;
+        } else if(argument_count < 3) {
+            arguments[argument_count++] = argv[i];
+        } else {
+            printf("Error: Too many arguments\n");
+            return ERR_INVALID_ARGUMENTS;
+        }
     }
 
-    // assign arguments
-    char *func = add_spaces(argv[1]);
-    char *outfile = argv[2];
-    char *limits = argc > 3 ? argv[3] : NULL;
-
-
-    printf("Function %s\n", func);
-    printf("Outfile %s\n", outfile);
-    printf("Limits %s\n", limits);
-
-    // check if the function contains the variable x
-    if(strstr(func, "x") == NULL) {
-        printf("Error: The function must contain the variable x.\n");
-        return ERR_INVALID_FUNCTION;
+    // check the number of arguments
+    // the job file and the daemon replace the positional arguments
+    int modes = (jobs != NULL) + (socket_path != NULL);
+    if(modes > 1 || (modes ? argument_count > 0 : argument_count < 2)) {
+        printf("Error: Missing arguments\nCode needs all these arguments: graph.exe <func>[@rrggbb][;<func>[@rrggbb]...] <out-file> [<limits>] [--simplify=<tolerance>] [--threads=<count>] [--dump] [--backend=<interpreter|jit|c>] [--sampler=<subdivision|derivative>] [--derivative] [--stats] [--trace=<file>] [--tiles=<directory>] [--export=<file|shm:name>] [--export-type=<float64|float32>]\n"
+               "or: graph.exe --jobs=<file> [<options>]\n"
+               "or: graph.exe --daemon=<socket> [<options>]\n");
+        return ERR_INVALID_ARGUMENTS;
     }
 
-    // check if the function contains only allowed characters and functions
-    if(!is_valid_function(func)) {
-        printf("Error: The function contains invalid characters or unsupported functions.\n");
-        free(func);
-        return ERR_INVALID_FUNCTION;
+    // the graphs of several jobs would overwrite one export
+    if(modes && o.export_target) {
+        printf("Error: --export applies to a single graph.\n");
+        return ERR_INVALID_ARGUMENTS;
     }
 
-
-
-    // parse limits from input
-    double x_min = -10, x_max = 10, y_min = -10, y_max = 10;
-    if(limits) {
-        if (sscanf(limits, "%lf:%lf:%lf:%lf", &x_min, &x_max, &y_min, &y_max) != 4) {
-            fprintf(stderr, "Error: Invalid format for limits.\n");
-            return ERR_INVALID_LIMITS;
-        }
-
-        // ensure min is less than max
-        if(x_min >= x_max) {
-            fprintf(stderr, "Error: x_min must be less than x_max.\n");
-            return ERR_INVALID_LIMITS;
-        }
-        if(y_min >= y_max) {
-            fprintf(stderr, "Error: y_min must be less than y_max.\n");
-            return ERR_INVALID_LIMITS;
-        }
+    // measure the phases from here on
+    stats_start(trace);
+
+    int result;
+    if(jobs) {
+        // the programs of parallel jobs would interleave
+        o.dump = 0;
+        o.verbose = 0;
+        result = run_jobs(jobs, &o, o.threads);
+    } else if(socket_path) {
+        result = serve_daemon(socket_path, &o);
+    } else {
+        char error[ERROR_SIZE];
+        result = render_graph(arguments[0], arguments[1], NULL, arguments[2], &o, error);
+        if(result != SUCCESS) fprintf(stderr, "Error: %s\n", error);
     }
 
-	// create a PostScript file
-    postscript *ps = create_postscript(outfile, func, x_min, x_max, y_min, y_max);
-    if(!ps) {
-        free(func);
-        fprintf(stderr, "Error: Failed to create PostScript file.\n");
+    // report the measurements
+    if(statistics) stats_print(stdout);
+    if(!stats_finish()) {
+        fprintf(stderr, "Error: Failed to write the trace file %s\n", trace);
         return ERR_FILE_ERROR;
     }
 
-    // render axes, grid, and graph
-  	draw_square_axis(ps);
-    draw_ticks_and_labels(ps);
-    draw_graph(ps);
-
-    // close the PostScript file
-    close_postscript(ps);
-
-
-    // free allocated memory
-    free(func);
-
-
-    printf("Graph successfully generated in file: %s\n", outfile);
-    return SUCCESS;
+    if(result == SUCCESS && !jobs && !socket_path) printf("Graph successfully generated in file: %s\n", arguments[1]);
+    return result;
 }
-
-
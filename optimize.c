@@ -0,0 +1,535 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "postfixmath.h"
+#include "optimize.h"
+
+// constants
+#define POWI_LIMIT 16
+#define EULER 2.71828182845904523536
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+// node of the expression tree rebuilt from the program
+typedef struct {
+    opcode op;
+    function_id func;
+    double value;
+    int left;       // operand of unary nodes, left operand of binary nodes
+    int right;      // right operand of binary nodes
+} node;
+
+// distinct nodes of the expression, open addressing by the hash of a node
+typedef struct {
+    int *entries;   // indices of the nodes, -1 for empty entries
+    size_t mask;
+} node_table;
+
+// state of writing the expression back as postfix code
+typedef struct {
+    const node *nodes;
+    const int *uses;    // number of references of every node
+    int *slot;          // slot of a shared node once it is computed, -1 before
+    instruction *code;
+    uint length;
+    uint depth;         // maximal depth of the value stack
+    uint slots;
+} emitter;
+
+/* ____________________________________________________________________________
+
+    static int is_binary(opcode op)
+
+    Checks if an operation takes two operands
+
+    Parameters:
+        op - The operation
+
+    Returns:
+        1 for binary operations, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int is_binary(opcode op) {
+
+    return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_POW;
+}
+
+/* ____________________________________________________________________________
+
+    static int is_constant(const node *nodes, int i, double value)
+
+    Checks if a node is a constant with the given value
+
+    Parameters:
+        nodes - The nodes of the tree
+        i - Index of the node
+        value - The expected value
+
+    Returns:
+        1 if the node is the constant, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int is_constant(const node *nodes, int i, double value) {
+
+    return nodes[i].op == OP_CONST && nodes[i].value == value;
+}
+
+/* ____________________________________________________________________________
+
+    static int is_leaf(opcode op)
+
+    Checks if an operation takes no operands
+
+    Parameters:
+        op - The operation
+
+    Returns:
+        1 for constants and x, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int is_leaf(opcode op) {
+
+    return op == OP_CONST || op == OP_X;
+}
+
+/* ____________________________________________________________________________
+
+    static int same_node(const node *a, const node *b)
+
+    Checks if two nodes compute the same value, the operands are compared
+    by their indices, so they have to be merged already
+
+    Parameters:
+        a - A pointer to the first node
+        b - A pointer to the second node
+
+    Returns:
+        1 if the nodes are identical, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int same_node(const node *a, const node *b) {
+
+    if(a->op != b->op || a->left != b->left || a->right != b->right) return 0;
+    if(a->op == OP_FUNC && a->func != b->func) return 0;
+
+    // constants are compared bit by bit, 0 and -0 differ
+    if(a->op == OP_CONST || a->op == OP_POWI) return memcmp(&a->value, &b->value, sizeof(double)) == 0;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static size_t hash_node(const node *n)
+
+    Computes the hash of a node from the fields compared by same_node
+
+    Parameters:
+        n - A pointer to the node
+
+    Returns:
+        The hash of the node
+   ____________________________________________________________________________
+*/
+static size_t hash_node(const node *n) {
+
+    uint64_t bits = 0;
+    if(n->op == OP_CONST || n->op == OP_POWI) memcpy(&bits, &n->value, sizeof(bits));
+
+    uint64_t h = (uint64_t)n->op;
+    h = (h * HASH_MULTIPLIER) ^ bits;
+    h = (h * HASH_MULTIPLIER) ^ (uint64_t)(n->op == OP_FUNC ? n->func : 0);
+    h = (h * HASH_MULTIPLIER) ^ (uint64_t)(uint32_t)n->left;
+    h = (h * HASH_MULTIPLIER) ^ (uint64_t)(uint32_t)n->right;
+
+    return (size_t)(h ^ (h >> 32));
+}
+
+/* ____________________________________________________________________________
+
+    static int intern(node_table *t, const node *nodes, int i)
+
+    Finds the node identical to a node, the node is added if it is the
+    first of its kind
+
+    Parameters:
+        t - A pointer to the table of the distinct nodes
+        nodes - The nodes of the expression
+        i - Index of the node
+
+    Returns:
+        The index of the identical node, i if there is none
+   ____________________________________________________________________________
+*/
+static int intern(node_table *t, const node *nodes, int i) {
+
+    size_t h = hash_node(&nodes[i]) & t->mask;
+
+    while(t->entries[h] >= 0) {
+        if(same_node(&nodes[t->entries[h]], &nodes[i])) return t->entries[h];
+        h = (h + 1) & t->mask;
+    }
+    t->entries[h] = i;
+
+    return i;
+}
+
+/* ____________________________________________________________________________
+
+    static double fold(const node *nodes, const node *n)
+
+    Computes the value of a node whose operands are constants
+
+    Parameters:
+        nodes - The nodes of the tree
+        n - A pointer to the node
+
+    Returns:
+        The value of the node
+   ____________________________________________________________________________
+*/
+static double fold(const node *nodes, const node *n) {
+
+    double a = nodes[n->left].value;
+    double b = is_binary(n->op) ? nodes[n->right].value : 0.0;
+
+    switch(n->op) {
+        case OP_ADD: return a + b;
+        case OP_SUB: return a - b;
+        case OP_MUL: return a * b;
+        case OP_DIV: return a / b;
+        case OP_POW: return pow(a, b);
+        case OP_NEG: return -a;
+        case OP_FUNC: return evaluate_function(n->func, a);
+        case OP_POWI: return power_int(a, (int)n->value);
+        default: return n->value;
+    }
+}
+
+/* ____________________________________________________________________________
+
+    static void simplify(node *nodes, int i, node_table *t, int *count)
+
+    Simplifies a node whose operands are already simplified and merged:
+
+    - operations on constants are folded into a constant
+    - e ^ u becomes exp(u)
+    - u ^ n with a small integer n becomes a chain of multiplications
+    - u / c becomes u * (1 / c)
+    - u * 1, 1 * u, u + 0, 0 + u, u - 0, u / 1, u ^ 1 and -(-u) become u
+
+    Operands may be shared, so they are never modified, new constants are
+    appended behind the nodes.
+
+    Parameters:
+        nodes - The nodes of the expression
+        i - Index of the node
+        t - A pointer to the table of the distinct nodes
+        count - A pointer to the number of nodes
+
+    Returns:
+        Nothing. The node is rewritten in place
+   ____________________________________________________________________________
+*/
+static void simplify(node *nodes, int i, node_table *t, int *count) {
+
+    node *n = &nodes[i];
+    if(n->op == OP_CONST || n->op == OP_X) return;
+
+    int l = n->left;
+    int r = n->right;
+
+    // fold operations whose operands are independent of x
+    if(nodes[l].op == OP_CONST && (!is_binary(n->op) || nodes[r].op == OP_CONST)) {
+        n->value = fold(nodes, n);
+        n->op = OP_CONST;
+        return;
+    }
+
+    switch(n->op) {
+        case OP_NEG:
+            if(nodes[l].op == OP_NEG) *n = nodes[nodes[l].left];
+            break;
+
+        case OP_ADD:
+            if(is_constant(nodes, r, 0.0)) *n = nodes[l];
+            else if(is_constant(nodes, l, 0.0)) *n = nodes[r];
+            break;
+
+        case OP_SUB:
+            if(is_constant(nodes, r, 0.0)) *n = nodes[l];
+            break;
+
+        case OP_MUL:
+            if(is_constant(nodes, r, 1.0)) *n = nodes[l];
+            else if(is_constant(nodes, l, 1.0)) *n = nodes[r];
+            break;
+
+        case OP_DIV:
+            if(is_constant(nodes, r, 1.0)) {
+                *n = nodes[l];
+            } else if(nodes[r].op == OP_CONST && nodes[r].value != 0.0 && isfinite(nodes[r].value)) {
+                int c = (*count)++;
+                nodes[c] = nodes[r];
+                nodes[c].value = 1.0 / nodes[r].value;
+                n->op = OP_MUL;
+                n->right = intern(t, nodes, c);
+            }
+            break;
+
+        case OP_POW:
+            if(is_constant(nodes, l, EULER)) {
+                n->op = OP_FUNC;
+                n->func = FUNC_EXP;
+                n->left = r;
+                n->right = -1;
+            } else if(is_constant(nodes, r, 1.0)) {
+                *n = nodes[l];
+            } else if(nodes[r].op == OP_CONST && nodes[r].value == floor(nodes[r].value) &&
+                      fabs(nodes[r].value) <= POWI_LIMIT) {
+                n->op = OP_POWI;
+                n->value = nodes[r].value;
+                n->right = -1;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* ____________________________________________________________________________
+
+    static void count_uses(const node *nodes, int i, int *uses)
+
+    Counts the references of the nodes reachable from a node, the operands
+    of a node are visited only on its first reference
+
+    Parameters:
+        nodes - The nodes of the expression
+        i - Index of the node
+        uses - The counters of the references, zero before the first call
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void count_uses(const node *nodes, int i, int *uses) {
+
+    if(uses[i]++ > 0 || is_leaf(nodes[i].op)) return;
+
+    count_uses(nodes, nodes[i].left, uses);
+    if(is_binary(nodes[i].op)) count_uses(nodes, nodes[i].right, uses);
+}
+
+/* ____________________________________________________________________________
+
+    static uint tree_size(const node *nodes, int i, uint *sizes)
+
+    Computes the number of operations of the expression below a node as if
+    no subexpression was shared, leaves are not counted
+
+    Parameters:
+        nodes - The nodes of the expression
+        i - Index of the node
+        sizes - The sizes computed so far, zero for the others
+
+    Returns:
+        The size of the subtree
+   ____________________________________________________________________________
+*/
+static uint tree_size(const node *nodes, int i, uint *sizes) {
+
+    if(sizes[i] == 0 && !is_leaf(nodes[i].op)) {
+        sizes[i] = 1 + tree_size(nodes, nodes[i].left, sizes);
+        if(is_binary(nodes[i].op)) sizes[i] += tree_size(nodes, nodes[i].right, sizes);
+    }
+
+    return sizes[i];
+}
+
+/* ____________________________________________________________________________
+
+    static void emit_node(emitter *e, opcode op, function_id func, double value)
+
+    Appends an instruction to the written code
+
+    Parameters:
+        e - A pointer to the emitter
+        op - The operation of the instruction
+        func - The function identifier for OP_FUNC
+        value - The constant, exponent or slot of the instruction
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void emit_node(emitter *e, opcode op, function_id func, double value) {
+
+    instruction *in = &e->code[e->length++];
+    in->op = op;
+    in->func = func;
+    in->value = value;
+}
+
+/* ____________________________________________________________________________
+
+    static void emit_dag(emitter *e, int i, uint depth)
+
+    Writes the subexpression of a node as postfix instructions. A node with
+    several references is computed once and stored into a slot, the later
+    references load it from there.
+
+    Parameters:
+        e - A pointer to the emitter
+        i - Index of the node
+        depth - The depth of the value stack before the subexpression
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void emit_dag(emitter *e, int i, uint depth) {
+
+    const node *n = &e->nodes[i];
+
+    // the value is already computed
+    if(e->slot[i] >= 0) {
+        emit_node(e, OP_LOAD, FUNC_SIN, (double)e->slot[i]);
+        if(depth + 1 > e->depth) e->depth = depth + 1;
+        return;
+    }
+
+    if(!is_leaf(n->op)) {
+        emit_dag(e, n->left, depth);
+        if(is_binary(n->op)) emit_dag(e, n->right, depth + 1);
+    } else if(depth + 1 > e->depth) {
+        e->depth = depth + 1;
+    }
+
+    emit_node(e, n->op, n->func, n->value);
+
+    // keep the value for the other references, leaves are cheaper to repeat
+    if(e->uses[i] > 1 && !is_leaf(n->op)) {
+        e->slot[i] = (int)e->slots++;
+        emit_node(e, OP_STORE, FUNC_SIN, (double)e->slot[i]);
+    }
+}
+
+/* ____________________________________________________________________________
+
+    int program_optimize(program *p, uint *removed, arena *scratch)
+
+    Optimizes a compiled program. The postfix code is turned back into an
+    expression, every node is simplified after its operands and merged
+    with an identical node if there is one, so the expression becomes a
+    DAG in which every distinct subexpression appears once. The DAG is
+    written back as postfix code, subexpressions with several references
+    are computed once per sample and kept in slots.
+
+    Parameters:
+        p - A pointer to the compiled program, optimized in place
+        removed - A pointer receiving the number of operations removed by
+                  the merging, may be NULL
+        scratch - The arena of the expression or NULL for the heap, the
+                  optimized code is always allocated from the heap
+
+    Returns:
+        1 on success, 0 if memory allocation fails or invalid parameters
+        are provided
+   ____________________________________________________________________________
+*/
+int program_optimize(program *p, uint *removed, arena *scratch) {
+
+    // sanity check
+    if(removed) *removed = 0;
+    if(!p || !p->code || p->length == 0) return 0;
+
+    // every division by a constant may append one reciprocal
+    int capacity = 2 * (int)p->length;
+    size_t table_size = 1;
+    while(table_size < 2 * (size_t)capacity) table_size <<= 1;
+
+    node *nodes = (node *)arena_alloc(scratch, sizeof(node) * capacity);
+    int *operands = (int *)arena_alloc(scratch, sizeof(int) * p->length);
+    int *uses = (int *)arena_calloc(scratch, capacity, sizeof(int));
+    int *slot = (int *)arena_alloc(scratch, sizeof(int) * capacity);
+    uint *sizes = (uint *)arena_calloc(scratch, capacity, sizeof(uint));
+    node_table t = {(int *)arena_alloc(scratch, sizeof(int) * table_size), table_size - 1};
+    int ok = nodes && operands && uses && slot && sizes && t.entries;
+
+    instruction *code = NULL;
+    double *stack = NULL;
+
+    if(ok) {
+        for(size_t i = 0; i < table_size; i++) t.entries[i] = -1;
+
+        // rebuild the expression, the program was validated by program_create
+        int count = (int)p->length;
+        int sp = -1;
+        for(uint i = 0; i < p->length; i++) {
+            node *n = &nodes[i];
+            n->op = p->code[i].op;
+            n->func = p->code[i].func;
+            n->value = p->code[i].value;
+            n->left = n->right = -1;
+
+            if(is_binary(n->op)) {
+                n->right = operands[sp--];
+                n->left = operands[sp--];
+            } else if(!is_leaf(n->op)) {
+                n->left = operands[sp--];
+            }
+
+            simplify(nodes, (int)i, &t, &count);
+            operands[++sp] = intern(&t, nodes, (int)i);
+        }
+
+        // count the references and the operations saved by sharing
+        int root = operands[0];
+        count_uses(nodes, root, uses);
+        uint distinct = 0, operations = 0, references = 0;
+        for(int i = 0; i < count; i++) {
+            slot[i] = -1;
+            if(uses[i] > 0) distinct++;
+            if(uses[i] > 0 && !is_leaf(nodes[i].op)) operations++;
+            references += (uint)uses[i];
+        }
+        if(removed) *removed = tree_size(nodes, root, sizes) - operations;
+
+        // every node is written once, every reference at most adds a load
+        // and every shared node a store
+        code = (instruction *)malloc(sizeof(instruction) * (distinct + 2 * references));
+        ok = code != NULL;
+
+        if(ok) {
+            emitter e = {nodes, uses, slot, code, 0, 0, 0};
+            emit_dag(&e, root, 0);
+
+            stack = (double *)malloc(sizeof(double) * (e.depth + e.slots) * PROGRAM_BLOCK_SIZE);
+            ok = stack != NULL;
+
+            if(ok) {
+                free(p->code);
+                free(p->stack);
+                p->code = code;
+                p->stack = stack;
+                p->length = e.length;
+                p->depth = e.depth;
+                p->slots = e.slots;
+            } else {
+                free(code);
+            }
+        }
+    }
+
+    arena_release(scratch, nodes);
+    arena_release(scratch, operands);
+    arena_release(scratch, uses);
+    arena_release(scratch, slot);
+    arena_release(scratch, sizes);
+    arena_release(scratch, t.entries);
+
+    return ok;
+}
@@ -0,0 +1,15 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "arena.h"
+#include "postfixmath.h"
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int program_optimize(program *p, uint *removed, arena *scratch);
+
+#endif //OPTIMIZE_H
@@ -1,221 +1,593 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <math.h>
-#include "stack.h"
-#include "queue.h"
 #include "postfixmath.h"
+#include "vecmath.h"
 
 
 // constants
-#define STACK_SIZE 20
 #define GRID_SIZE 60.0
 
 /* ____________________________________________________________________________
 
-    double evaluate_function(char *func, double x)
+    double evaluate_function(function_id func, double x)
 
-    Evaluates a mathematical function for a given X value.
+    Evaluates a mathematical function for a given X value through the
+    function registry.
 
     Parameters:
-        func - The mathematical function as a string.
+        func - The identifier of the function.
         x - The X value to evaluate.
 
     Returns:
         The result of the function evaluation or NAN if the function is invalid.
    ____________________________________________________________________________
 */
-double evaluate_function( char *func, double x) {
+double evaluate_function(function_id func, double x) {
 
-    // sanity check
-    if(!func) return NAN;
-
-
-    // Compare and evaluate functions
-    if(strstr(func, "sin") == func) {
-        return sin(x);
-    }else if(strstr(func, "cos") == func) {
-        return cos(x);
-    }else if(strstr(func, "tan") == func) {
-        return tan(x);
-    }else if(strstr(func, "asin") == func) {
-        return asin(x);
-    }else if(strstr(func, "acos") == func) {
-        return acos(x);
-    }else if(strstr(func, "atan") == func) {
-        return atan(x);
-    }else if(strstr(func, "sinh") == func) {
-        return sinh(x);
-    }else if(strstr(func, "cosh") == func) {
-        return cosh(x);
-    }else if(strstr(func, "tanh") == func) {
-        return tanh(x);
-    }else if(strstr(func, "log") == func) {
-        return log10(x);
-    }else if(strstr(func, "ln") == func) {
-        return log(x);
-    }else if(strstr(func, "sqrt") == func) {
-        return sqrt(x);
-    }else if(strstr(func, "abs") == func) {
-        return fabs(x);
-    }
+    if((unsigned int)func >= FUNC_COUNT) return NAN;
+
+    return function_table[func].scalar(x);
+}
+
+/* ____________________________________________________________________________
+
+    double power_int(double base, int exponent)
+
+    Raises a number to an integer power by a chain of multiplications
+
+    Parameters:
+        base - The base
+        exponent - The integer exponent
 
+    Returns:
+        The base raised to the exponent
+   ____________________________________________________________________________
+*/
+double power_int(double base, int exponent) {
+
+    unsigned int n = exponent < 0 ? -(unsigned int)exponent : (unsigned int)exponent;
+    double result = 1.0;
+
+    // square and multiply
+    while(n > 0) {
+        if(n & 1) result *= base;
+        base *= base;
+        n >>= 1;
+    }
 
-    return x;
+    return exponent < 0 ? 1.0 / result : result;
 }
 
 /* ____________________________________________________________________________
 
-    double evaluate_postfix_expression(queue *expression, double x_value)
+    void evaluate_function_batch(function_id func, double *values, size_t n)
 
-    Evaluates a mathematical expression in Reverse Polish Notation (RPN)
+    Evaluates a mathematical function over an array of values in place
 
     Parameters:
-        expression - A queue containing the postfix expression
-        x_value - The value of the variable X for evaluation
+        func - The identifier of the function
+        values - The arguments, overwritten by the results
+        n - The number of values
 
     Returns:
-        The result of the evaluation or NAN if the evaluation fails
+        Nothing. The results are stored in the values array
    ____________________________________________________________________________
 */
-double evaluate_postfix_expression(queue *expression, double x_value) {
+void evaluate_function_batch(function_id func, double *values, size_t n) {
 
     // sanity check
-    if(!expression) return NAN;
+    if(!values) return;
 
-    // create a stack for evaluation
-    stack *s = stack_create(STACK_SIZE, sizeof(double));
-    if(!s) return NAN;
-
-    // copy the queue for safety iterating
-    queue *expression_copy = queue_copy(expression);
-    if(!expression_copy) {
-        stack_free(&s);
-        return NAN;
+    // dispatch once, then run a tight loop or a vector kernel over the block
+    if((unsigned int)func >= FUNC_COUNT) {
+        for(size_t i = 0; i < n; i++) values[i] = NAN;
+        return;
     }
 
-    // helping values
-    double a, b, result = 0.0;
-    char token;
+    function_table[func].batch(values, n);
+}
+
+/* ____________________________________________________________________________
 
-    // buffers for reading numbers and functions
-    char number_buffer[32] = {0};
-    int number_index = 0;
-    char function_name[16] = {0};
-    int function_index = 0;
+    static void emit(program *p, opcode op, function_id func, double value)
 
-    // indicator for unary minus
-    int is_unary = 0;
+    Appends an instruction to the compiled program
 
-    while(queue_dequeue(expression_copy, &token)) {
+    Parameters:
+        p - A pointer to the program
+        op - The operation of the instruction
+        func - The function identifier for OP_FUNC
+        value - The constant for OP_CONST
 
-        // if the token is a digit or a decimal point
-        if(isdigit(token) || token == '.') {
-            number_buffer[number_index++] = token;
-        }
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void emit(program *p, opcode op, function_id func, double value) {
 
-        // if the token is scientific notation E
-        else if(token == 'E') {
-            number_buffer[number_index++] = 'E';
-        }
+    instruction *in = &p->code[p->length++];
+    in->op = op;
+    in->func = func;
+    in->value = value;
+}
+
+/* ____________________________________________________________________________
+
+    program *program_create(queue_token *expression)
+
+    Compiles a postfix expression produced by the shunting yard algorithm
+    into a program, every token becomes one instruction. The depth of the
+    value stack is checked here, so the evaluation never has to validate
+    it again.
+
+    Parameters:
+        expression - A queue containing the postfix tokens, the queue is
+                     left unchanged
+
+    Returns:
+        A pointer to the compiled program or NULL if the expression is invalid
+   ____________________________________________________________________________
+*/
+program *program_create(queue_token *expression) {
+
+    // sanity check
+    if(!expression || expression->count == 0) return NULL;
+
+    // allocate memory for the program
+    program *p = (program *)malloc(sizeof(program));
+    if(!p) return NULL;
+    p->length = 0;
+    p->depth = 0;
+    p->slots = 0;
+    p->stack = NULL;
+    p->native = NULL;
+    p->native_batch = NULL;
+    p->evaluations = 0;
+
+    p->code = (instruction *)malloc(sizeof(instruction) * expression->count);
+    if(!p->code) {
+        free(p);
+        return NULL;
+    }
+
+    // current depth of the value stack
+    int depth = 0;
 
-        // if the token is a unary minus ~
-        else if(token == '~') {
-            is_unary = 1;
+    token t;
+    for(size_t i = 0; queue_token_get(expression, i, &t); i++) {
+
+        // operands
+        if(t.type == TOKEN_NUMBER || t.type == TOKEN_X) {
+            emit(p, t.type == TOKEN_X ? OP_X : OP_CONST, 0, t.value);
+            depth++;
         }
-        // push the value of x_value for x
-        if(token == 'x') {
-            if(is_unary) {
-                // apply unary minus
-                x_value = -x_value;
-                is_unary = 0;
+
+        // functions and the unary minus
+        else if(t.type == TOKEN_FUNCTION || t.type == TOKEN_NEG) {
+            if(depth < 1) {
+                program_free(&p);
+                return NULL;
             }
-            stack_push(s, &x_value);
+            emit(p, t.type == TOKEN_NEG ? OP_NEG : OP_FUNC, t.func, 0.0);
         }
 
-        // if the number is complete or followed by another token
-        else if(number_index > 0 && (strchr("+-*/^~$", token) || isalpha(token) || token == 'x')) {
-            number_buffer[number_index] = '\0'; // terminate the number string
-            double num = atof(number_buffer);  // convert to double
-            if(is_unary) {
-                // aplly unary minus
-                num = -num;
-                is_unary = 0;
+        // binary operators
+        else if(t.type >= TOKEN_ADD && t.type <= TOKEN_POW) {
+            if(depth < 2) {
+                program_free(&p);
+                return NULL;
             }
-            stack_push(s, &num);
-            memset(number_buffer, 0, sizeof(number_buffer)); // Vymazání bufferu
-            number_index = 0;
+            switch(t.type) {
+                case TOKEN_ADD: emit(p, OP_ADD, 0, 0.0); break;
+                case TOKEN_SUB: emit(p, OP_SUB, 0, 0.0); break;
+                case TOKEN_MUL: emit(p, OP_MUL, 0, 0.0); break;
+                case TOKEN_DIV: emit(p, OP_DIV, 0, 0.0); break;
+                default: emit(p, OP_POW, 0, 0.0); break;
+            }
+            depth--;
         }
 
-        // if the token is part of a function name
-        else if(isalpha(token) && token != '$') {
-            function_name[function_index++] = token;
+        // brackets left over by an unbalanced expression
+        else {
+            program_free(&p);
+            return NULL;
         }
 
-        // if the token marks the end of a function $
-        else if(token == '$') {
-            function_name[function_index] = '\0'; // terminate the function name
-            if(!stack_pop(s, &a)) {
-                queue_free(&expression_copy);
-                stack_free(&s);
-                return NAN;
-            }
-            if(is_unary) {
-                // apply unary minus to the function result
-                a = -a;
-                is_unary = 0;
-            }
-            result = evaluate_function(function_name, a);
-            stack_push(s, &result);
+        if(depth > (int)p->depth) p->depth = depth;
+    }
+
+    // exactly one result has to remain
+    if(depth != 1) {
+        program_free(&p);
+        return NULL;
+    }
+
+    // preallocate the value stack, large enough for the batch evaluation
+    p->stack = (double *)malloc(sizeof(double) * (p->depth + p->slots) * PROGRAM_BLOCK_SIZE);
+    if(!p->stack) {
+        program_free(&p);
+        return NULL;
+    }
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    program *program_copy(const program *original)
+
+    Creates a copy of the compiled program with its own value stack, so the
+    copy can be evaluated in another thread
+
+    Parameters:
+        original - A pointer to the original program
+
+    Returns:
+        A pointer to the newly created copy of the program
+   ____________________________________________________________________________
+*/
+program *program_copy(const program *original) {
+
+    // sanity check
+    if(!original || !original->code) return NULL;
+
+    program *p = (program *)malloc(sizeof(program));
+    if(!p) return NULL;
+    p->length = original->length;
+    p->depth = original->depth;
+    p->slots = original->slots;
+    p->native = original->native;
+    p->native_batch = original->native_batch;
+    p->evaluations = 0;
+    p->code = (instruction *)malloc(sizeof(instruction) * original->length);
+    p->stack = (double *)malloc(sizeof(double) * (original->depth + original->slots) * PROGRAM_BLOCK_SIZE);
+    if(!p->code || !p->stack) {
+        program_free(&p);
+        return NULL;
+    }
+
+    memcpy(p->code, original->code, sizeof(instruction) * original->length);
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    double evaluate_postfix_expression(program *p, double x_value)
+
+    Evaluates a compiled mathematical expression on the preallocated stack
+
+    Parameters:
+        p - A pointer to the compiled program
+        x_value - The value of the variable X for evaluation
+
+    Returns:
+        The result of the evaluation or NAN if the evaluation fails
+   ____________________________________________________________________________
+*/
+double evaluate_postfix_expression(program *p, double x_value) {
 
-            // clear the function buffer
-            memset(function_name, 0, sizeof(function_name));
-            function_index = 0;
+    // sanity check
+    if(!p || !p->stack) return NAN;
+
+    p->evaluations++;
+
+    // the native code replaces the interpreter
+    if(p->native) return p->native(x_value);
+
+    double *s = p->stack;
+    int sp = -1;
+
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+
+        switch(in->op) {
+            case OP_CONST: s[++sp] = in->value; break;
+            case OP_X: s[++sp] = x_value; break;
+            case OP_ADD: sp--; s[sp] = s[sp] + s[sp + 1]; break;
+            case OP_SUB: sp--; s[sp] = s[sp] - s[sp + 1]; break;
+            case OP_MUL: sp--; s[sp] = s[sp] * s[sp + 1]; break;
+            case OP_DIV: sp--; s[sp] = s[sp] / s[sp + 1]; break;
+            case OP_POW: sp--; s[sp] = pow(s[sp], s[sp + 1]); break;
+            case OP_NEG: s[sp] = -s[sp]; break;
+            case OP_FUNC: s[sp] = evaluate_function(in->func, s[sp]); break;
+            case OP_POWI: s[sp] = power_int(s[sp], (int)in->value); break;
+            case OP_STORE: s[p->depth + (uint)in->value] = s[sp]; break;
+            case OP_LOAD: s[++sp] = s[p->depth + (uint)in->value]; break;
         }
+    }
+
+    return s[0];
+}
+
+/* ____________________________________________________________________________
+
+    static double function_slope(function_id func, double x, double value)
+
+    Computes the derivative of a supported function
+
+    Parameters:
+        func - The identifier of the function
+        x - The argument
+        value - The value of the function at x
+
+    Returns:
+        The derivative of the function at x
+   ____________________________________________________________________________
+*/
+static double function_slope(function_id func, double x, double value) {
+
+    if((unsigned int)func >= FUNC_COUNT) return NAN;
+
+    return function_table[func].derivative(x, value);
+}
 
-        // if the token is an operator
-        else if(strchr("+-*/^", token)) {
-            if(!stack_pop(s, &b) || !stack_pop(s, &a)) {
-                queue_free(&expression_copy);
-                stack_free(&s);
-                return NAN;
+/* ____________________________________________________________________________
+
+    double evaluate_postfix_dual(program *p, double x_value, double *slope)
+
+    Evaluates a compiled mathematical expression on dual numbers, every
+    value of the stack carries its derivative by x, so the function and its
+    derivative are computed in one pass. The native code is not used.
+
+    Parameters:
+        p - A pointer to the compiled program
+        x_value - The value of the variable X for evaluation
+        slope - A pointer receiving the derivative at x_value
+
+    Returns:
+        The result of the evaluation or NAN if the evaluation fails
+   ____________________________________________________________________________
+*/
+double evaluate_postfix_dual(program *p, double x_value, double *slope) {
+
+    // sanity check
+    if(!slope) return NAN;
+    *slope = NAN;
+    if(!p || !p->stack) return NAN;
+
+    p->evaluations++;
+
+    // the derivatives follow the values and the shared values
+    uint width = p->depth + p->slots;
+    double *s = p->stack;
+    double *d = p->stack + width;
+    int sp = -1;
+
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+
+        switch(in->op) {
+            case OP_CONST: sp++; s[sp] = in->value; d[sp] = 0.0; break;
+            case OP_X: sp++; s[sp] = x_value; d[sp] = 1.0; break;
+            case OP_ADD: sp--; s[sp] = s[sp] + s[sp + 1]; d[sp] = d[sp] + d[sp + 1]; break;
+            case OP_SUB: sp--; s[sp] = s[sp] - s[sp + 1]; d[sp] = d[sp] - d[sp + 1]; break;
+            case OP_MUL:
+                sp--;
+                d[sp] = d[sp] * s[sp + 1] + s[sp] * d[sp + 1];
+                s[sp] = s[sp] * s[sp + 1];
+                break;
+            case OP_DIV:
+                sp--;
+                d[sp] = (d[sp] * s[sp + 1] - s[sp] * d[sp + 1]) / (s[sp + 1] * s[sp + 1]);
+                s[sp] = s[sp] / s[sp + 1];
+                break;
+            case OP_POW: {
+                sp--;
+                double value = pow(s[sp], s[sp + 1]);
+
+                // a constant exponent keeps negative bases of integer powers
+                if(d[sp + 1] == 0.0) d[sp] = s[sp + 1] * pow(s[sp], s[sp + 1] - 1.0) * d[sp];
+                else d[sp] = value * (d[sp + 1] * log(s[sp]) + s[sp + 1] * d[sp] / s[sp]);
+                s[sp] = value;
+                break;
             }
-            switch(token) {
-                case '+': result = a + b; break;
-                case '-': result = a - b; break;
-                case '*': result = a * b; break;
-                case '/': result = a / b; break;
-                case '^': result = pow(a, b); break;
-                default:
-                    queue_free(&expression_copy);
-                    stack_free(&s);
-                    return NAN;
+            case OP_NEG: s[sp] = -s[sp]; d[sp] = -d[sp]; break;
+            case OP_FUNC: {
+                double value = evaluate_function(in->func, s[sp]);
+                d[sp] = isnan(value) ? NAN : function_slope(in->func, s[sp], value) * d[sp];
+                s[sp] = value;
+                break;
             }
-            stack_push(s, &result);
+            case OP_POWI: {
+                int n = (int)in->value;
+                d[sp] = n == 0 ? 0.0 : n * power_int(s[sp], n - 1) * d[sp];
+                s[sp] = power_int(s[sp], n);
+                break;
+            }
+            case OP_STORE:
+                s[p->depth + (uint)in->value] = s[sp];
+                d[p->depth + (uint)in->value] = d[sp];
+                break;
+            case OP_LOAD:
+                sp++;
+                s[sp] = s[p->depth + (uint)in->value];
+                d[sp] = d[p->depth + (uint)in->value];
+                break;
         }
     }
 
-     // process a number in the buffer
-    if(number_index > 0) {
-        number_buffer[number_index] = '\0';
-        double num = atof(number_buffer);
-        if (is_unary) {
-            num = -num;
+    *slope = d[0];
+    return s[0];
+}
+
+/* ____________________________________________________________________________
+
+    void evaluate_postfix_batch(program *p, const double *xs, double *ys, size_t n)
+
+    Evaluates a compiled mathematical expression for an array of X values.
+    The samples are processed in blocks of PROGRAM_BLOCK_SIZE and every
+    instruction runs over the whole block before the next one starts, so
+    the dispatch is paid once per block instead of once per sample.
+
+    Parameters:
+        p - A pointer to the compiled program
+        xs - The values of the variable X
+        ys - An array where the results will be stored
+        n - The number of values
+
+    Returns:
+        Nothing. The results are stored in ys, NAN if the evaluation fails
+   ____________________________________________________________________________
+*/
+void evaluate_postfix_batch(program *p, const double *xs, double *ys, size_t n) {
+
+    // sanity check
+    if(!xs || !ys) return;
+    if(!p || !p->stack) {
+        for(size_t i = 0; i < n; i++) ys[i] = NAN;
+        return;
+    }
+
+    p->evaluations += n;
+
+    // the native code evaluates the whole array or one sample per call
+    if(p->native_batch) {
+        p->native_batch(xs, ys, n);
+        return;
+    }
+    if(p->native) {
+        for(size_t i = 0; i < n; i++) ys[i] = p->native(xs[i]);
+        return;
+    }
+
+    for(size_t start = 0; start < n; start += PROGRAM_BLOCK_SIZE) {
+
+        // number of samples in the current block
+        size_t count = n - start < PROGRAM_BLOCK_SIZE ? n - start : PROGRAM_BLOCK_SIZE;
+
+        // the stack holds one column of samples per level
+        int sp = -1;
+
+        for(uint i = 0; i < p->length; i++) {
+            const instruction *in = &p->code[i];
+
+            // push a new column for operands
+            if(in->op == OP_CONST || in->op == OP_X || in->op == OP_LOAD) sp++;
+
+            double *top = p->stack + (size_t)sp * PROGRAM_BLOCK_SIZE;
+            double *a = sp > 0 ? top - PROGRAM_BLOCK_SIZE : top;
+
+            switch(in->op) {
+                case OP_CONST:
+                    for(size_t j = 0; j < count; j++) top[j] = in->value;
+                    break;
+                case OP_X:
+                    memcpy(top, xs + start, sizeof(double) * count);
+                    break;
+                case OP_ADD:
+                    for(size_t j = 0; j < count; j++) a[j] = a[j] + top[j];
+                    sp--;
+                    break;
+                case OP_SUB:
+                    for(size_t j = 0; j < count; j++) a[j] = a[j] - top[j];
+                    sp--;
+                    break;
+                case OP_MUL:
+                    for(size_t j = 0; j < count; j++) a[j] = a[j] * top[j];
+                    sp--;
+                    break;
+                case OP_DIV:
+                    for(size_t j = 0; j < count; j++) a[j] = a[j] / top[j];
+                    sp--;
+                    break;
+                case OP_POW:
+                    vec_pow(a, top, count);
+                    sp--;
+                    break;
+                case OP_NEG:
+                    for(size_t j = 0; j < count; j++) top[j] = -top[j];
+                    break;
+                case OP_FUNC:
+                    evaluate_function_batch(in->func, top, count);
+                    break;
+                case OP_POWI:
+                    if(in->value == 2.0) {
+                        for(size_t j = 0; j < count; j++) top[j] = top[j] * top[j];
+                    } else {
+                        for(size_t j = 0; j < count; j++) top[j] = power_int(top[j], (int)in->value);
+                    }
+                    break;
+                case OP_STORE:
+                    memcpy(p->stack + (size_t)(p->depth + (uint)in->value) * PROGRAM_BLOCK_SIZE,
+                           top, sizeof(double) * count);
+                    break;
+                case OP_LOAD:
+                    memcpy(top, p->stack + (size_t)(p->depth + (uint)in->value) * PROGRAM_BLOCK_SIZE,
+                           sizeof(double) * count);
+                    break;
+            }
         }
-        stack_push(s, &num);
+
+        memcpy(ys + start, p->stack, sizeof(double) * count);
     }
+}
+
+/* ____________________________________________________________________________
+
+    void program_dump(const program *p, FILE *out)
+
+    Writes a readable listing of the compiled program, one instruction
+    per line
 
-    // Final result on top of the stack
-    if(!stack_pop(s, &result)) {
-        queue_free(&expression_copy);
-        stack_free(&s);
-        return NAN;
+    Parameters:
+        p - A pointer to the compiled program
+        out - The stream receiving the listing
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void program_dump(const program *p, FILE *out) {
+
+    // sanity check
+    if(!p || !out) return;
+
+    fprintf(out, "program: %u instructions, stack depth %u, %u shared values\n", p->length, p->depth, p->slots);
+
+    for(uint i = 0; i < p->length; i++) {
+        const instruction *in = &p->code[i];
+
+        fprintf(out, "%4u  ", i);
+        switch(in->op) {
+            case OP_CONST: fprintf(out, "const %.17g\n", in->value); break;
+            case OP_X: fprintf(out, "x\n"); break;
+            case OP_ADD: fprintf(out, "add\n"); break;
+            case OP_SUB: fprintf(out, "sub\n"); break;
+            case OP_MUL: fprintf(out, "mul\n"); break;
+            case OP_DIV: fprintf(out, "div\n"); break;
+            case OP_POW: fprintf(out, "pow\n"); break;
+            case OP_NEG: fprintf(out, "neg\n"); break;
+            case OP_FUNC: fprintf(out, "call %s\n", function_table[in->func].name); break;
+            case OP_POWI: fprintf(out, "powi %d\n", (int)in->value); break;
+            case OP_STORE: fprintf(out, "store %u\n", (uint)in->value); break;
+            case OP_LOAD: fprintf(out, "load %u\n", (uint)in->value); break;
+        }
     }
+}
+
+/* ____________________________________________________________________________
+
+    void program_free(program **p)
+
+    Frees the memory allocated for the compiled program
+
+    Parameters:
+        p - A double pointer to the program to be freed
 
-    // free memory
-    queue_free(&expression_copy);
-    stack_free(&s);
+    Returns:
+        Nothing. The program pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void program_free(program **p) {
+
+    // sanity check
+    if(!p || !*p) return;
 
-    return result;
+    free((*p)->code);
+    free((*p)->stack);
+    free(*p);
+    *p = NULL;
 }
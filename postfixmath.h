@@ -1,7 +1,69 @@
 #ifndef POSTFIXMATH_H
 #define POSTFIXMATH_H
 
-#include "queue.h"
+#include <stddef.h>
+#include <stdio.h>
+#include "expression.h"
+
+// number of samples processed together by the batch evaluation
+#define PROGRAM_BLOCK_SIZE 256
+
+/* ____________________________________________________________________________
+
+    Compiled Program
+   ____________________________________________________________________________
+*/
+
+// operations of the compiled program
+typedef enum {
+    OP_CONST, OP_X,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW,
+    OP_NEG, OP_FUNC, OP_POWI,
+    OP_STORE, OP_LOAD
+} opcode;
+
+typedef struct {
+    opcode op;
+    function_id func;   // function for OP_FUNC
+    double value;       // constant for OP_CONST, integer exponent for OP_POWI,
+                        // slot of a shared value for OP_STORE and OP_LOAD
+} instruction;
+
+typedef struct {
+    instruction *code;
+    uint length;
+    uint depth;         // maximal depth of the value stack
+    uint slots;         // number of values shared by several subexpressions
+    double *stack;      // preallocated value stack followed by the shared
+                        // values, depth + slots columns of
+                        // PROGRAM_BLOCK_SIZE values for the batch evaluation
+    double (*native)(double);   // native code of the program, NULL to interpret
+    void (*native_batch)(const double *xs, double *ys, size_t n);   // optional sampling loop of the native code
+    unsigned long long evaluations; // number of evaluated samples
+} program;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+double evaluate_function(function_id func, double x);
+
+double power_int(double base, int exponent);
+
+program *program_create(queue_token *expression);
+
+program *program_copy(const program *original);
+
+double evaluate_postfix_expression(program *p, double x_value);
+
+double evaluate_postfix_dual(program *p, double x_value, double *slope);
+
+void evaluate_postfix_batch(program *p, const double *xs, double *ys, size_t n);
+
+void program_dump(const program *p, FILE *out);
+
+void program_free(program **p);
 
-double evaluate_postfix_expression(queue *expression, double x_value);
 #endif //POSTFIXMATH_H
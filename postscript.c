@@ -1,29 +1,388 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#ifdef _WIN32
+#include <io.h>
+#define fileno _fileno
+#define write(fd, data, size) _write(fd, data, (unsigned int)(size))
+#else
+#include <unistd.h>
+#endif
 #include "postscript.h"
 #include "stack.h"
 #include "shuntingyard.h"
 #include "postfixmath.h"
+#include "sampler.h"
+#include "optimize.h"
+#include "stats.h"
 
 // constants
 #define POST_SCRIPT_WIDTH 560
 #define POST_SCRIPT_HEIGHT 560
+#define OUTPUT_BUFFER_SIZE 65536
+#define OUTPUT_MAX_ITEM 64
+#define FIXED_LIMIT 4e15
+#define FIXED_SPLITTER 134217729.0
+#define RASTER_MARGIN 40
+#define RASTER_SCALE 2
 
+/* ____________________________________________________________________________
+
+    static void ps_flush(postscript *ps)
+
+    Writes the buffered output to the file in one system call
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+
+    Returns:
+        Nothing. The buffer is empty afterwards
+   ____________________________________________________________________________
+*/
+static void ps_flush(postscript *ps) {
+
+    int fd = fileno(ps->file);
+    size_t written = 0;
+
+    // streams in memory have no descriptor
+    if(fd < 0) written = fwrite(ps->buffer, 1, ps->buffered, ps->file);
+
+    // write can store less than requested, repeat until all is written
+    while(fd >= 0 && written < ps->buffered) {
+        long result = (long)write(fd, ps->buffer + written, ps->buffered - written);
+        if(result <= 0) break;
+        written += (size_t)result;
+    }
+
+    stats_count(COUNTER_BYTES, written);
+    ps->buffered = 0;
+}
 
 /* ____________________________________________________________________________
 
-    postscript *create_postscript(const char *filename, const char *func,
-                                  double x_min, double x_max,
-                                  double y_min, double y_max)
+    static void ps_text(postscript *ps, const char *text)
 
-    Creates a structure for generating a PostScript file
+    Appends a text to the output buffer
 
     Parameters:
-        filename - Name of the PostScript file to create
-        func - Mathematical function as a string in infix notation
+        ps - A pointer to the PostScript structure
+        text - The text to append
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_text(postscript *ps, const char *text) {
+
+    // raster images are drawn by their own functions
+    if(ps->image) return;
+
+    size_t length = strlen(text);
+
+    while(length > 0) {
+        if(ps->buffered == OUTPUT_BUFFER_SIZE) ps_flush(ps);
+
+        // copy as much as fits into the buffer
+        size_t part = OUTPUT_BUFFER_SIZE - ps->buffered;
+        if(part > length) part = length;
+        memcpy(ps->buffer + ps->buffered, text, part);
+        ps->buffered += part;
+        text += part;
+        length -= part;
+    }
+}
+
+/* ____________________________________________________________________________
+
+    size_t format_fixed(char *out, double value, int decimals)
+
+    Formats a number with a fixed number of decimals, the result is the same
+    as printf("%.*f", decimals, value) in the C locale. The exact product of
+    the value and the power of ten is rounded half to even, so no rounding
+    of the intermediate results can change the digits.
+
+    Parameters:
+        out - A buffer of at least OUTPUT_MAX_ITEM characters
+        value - The number to format
+        decimals - The number of decimals, 0 to 6
+
+    Returns:
+        The length of the formatted number
+   ____________________________________________________________________________
+*/
+size_t format_fixed(char *out, double value, int decimals) {
+
+    double scale = 1.0;
+    for(int i = 0; i < decimals && i < 6; i++) scale *= 10.0;
+
+    // values out of the exact range are left to the C library
+    if(!(fabs(value) * scale < FIXED_LIMIT) || decimals < 0 || decimals > 6) {
+        return (size_t)snprintf(out, OUTPUT_MAX_ITEM, "%.*f", decimals, value);
+    }
+
+    // exact product |value| * scale = hi + lo by Dekker's algorithm
+    double a = fabs(value);
+    double ca = a * FIXED_SPLITTER, cs = scale * FIXED_SPLITTER;
+    double a_hi = ca - (ca - a), a_lo = a - a_hi;
+    double s_hi = cs - (cs - scale), s_lo = scale - s_hi;
+    double hi = a * scale;
+    double lo = ((a_hi * s_hi - hi) + a_hi * s_lo + a_lo * s_hi) + a_lo * s_lo;
+
+    // round the exact product half to even
+    double whole = floor(hi);
+    double fraction = hi - whole;
+    unsigned long long digits = (unsigned long long)whole;
+    int up;
+    if(fraction > 0.5) {
+        up = 1;
+    } else if(fraction == 0.5) {
+        up = lo > 0.0 || (lo == 0.0 && (digits & 1));
+    } else {
+        up = 0.5 - fraction < lo;
+    }
+    digits += up;
+
+    // write the digits from the end
+    char reversed[OUTPUT_MAX_ITEM];
+    size_t n = 0;
+    for(int i = 0; i < decimals; i++) {
+        reversed[n++] = (char)('0' + digits % 10);
+        digits /= 10;
+    }
+    if(decimals > 0) reversed[n++] = '.';
+    do {
+        reversed[n++] = (char)('0' + digits % 10);
+        digits /= 10;
+    } while(digits > 0);
+
+    size_t length = 0;
+    if(signbit(value)) out[length++] = '-';
+    while(n > 0) out[length++] = reversed[--n];
+    out[length] = '\0';
+
+    return length;
+}
+
+/* ____________________________________________________________________________
+
+    static void ps_number(postscript *ps, double value, int decimals)
+
+    Appends a number with a fixed number of decimals to the output buffer
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        value - The number to append
+        decimals - The number of decimals
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_number(postscript *ps, double value, int decimals) {
+
+    char number[OUTPUT_MAX_ITEM];
+    format_fixed(number, value, decimals);
+    ps_text(ps, number);
+}
+
+/* ____________________________________________________________________________
+
+    static void ps_point(postscript *ps, double x, double y, const char *op)
+
+    Appends a point followed by a PostScript operator, for example
+    "10.00 20.00 lineto"
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        x, y - The coordinates of the point
+        op - The operator
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_point(postscript *ps, double x, double y, const char *op) {
+
+    char line[3 * OUTPUT_MAX_ITEM];
+    size_t length = format_fixed(line, x, 2);
+    line[length++] = ' ';
+    length += format_fixed(line + length, y, 2);
+    line[length++] = ' ';
+    line[length] = '\0';
+
+    ps_text(ps, line);
+    ps_text(ps, op);
+    ps_text(ps, "\n");
+}
+
+/* ____________________________________________________________________________
+
+    static void ps_pixel(const postscript *ps, double x, double y,
+                         double *px, double *py)
+
+    Converts a point of the PostScript space into the pixels of the raster
+    image, the plot is surrounded by a margin for the labels
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        x, y - The point in PostScript units
+        px, py - Pointers receiving the pixel coordinates, y grows downwards
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_pixel(const postscript *ps, double x, double y, double *px, double *py) {
+
+    *px = (x - ps->x_min * ps->scale_x + RASTER_MARGIN) * RASTER_SCALE;
+    *py = (ps->y_max * ps->scale_y - y + RASTER_MARGIN) * RASTER_SCALE;
+}
+
+/* ____________________________________________________________________________
+
+    static void ps_segment(postscript *ps, double x0, double y0, double x1, double y1)
+
+    Strokes a line between two points
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        x0, y0 - The start of the line in PostScript units
+        x1, y1 - The end of the line
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_segment(postscript *ps, double x0, double y0, double x1, double y1) {
+
+    if(ps->image) {
+        double px0, py0, px1, py1;
+        ps_pixel(ps, x0, y0, &px0, &py0);
+        ps_pixel(ps, x1, y1, &px1, &py1);
+        raster_line(ps->image, px0, py0, px1, py1);
+        raster_stroke(ps->image);
+        return;
+    }
+
+    ps_text(ps, "newpath\n");
+    ps_point(ps, x0, y0, "moveto");
+    ps_point(ps, x1, y1, "lineto");
+    ps_text(ps, "stroke\n");
+}
+
+/* ____________________________________________________________________________
+
+    static void ps_label(postscript *ps, double x, double y, double value)
+
+    Draws a number with one decimal as a label
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        x, y - The left end of the baseline in PostScript units
+        value - The number
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void ps_label(postscript *ps, double x, double y, double value) {
+
+    if(ps->image) {
+        char number[OUTPUT_MAX_ITEM];
+        double px, py;
+        format_fixed(number, value, 1);
+        ps_pixel(ps, x, y, &px, &py);
+        raster_text(ps->image, px, py, RASTER_SCALE, number);
+        return;
+    }
+
+    ps_point(ps, x, y, "moveto");
+    ps_text(ps, "(");
+    ps_number(ps, value, 1);
+    ps_text(ps, ") show\n");
+}
+
+
+/* ____________________________________________________________________________
+
+    static void discard_postscript(postscript *ps)
+
+    Closes the file and frees the structure without writing the rest of
+    the graph
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void discard_postscript(postscript *ps) {
+
+    if(ps->file) fclose(ps->file);
+
+    // free memory
+    for(size_t i = 0; i < ps->plot_count; i++) {
+        program_free(&ps->plots[i].func);
+        jit_free(&ps->plots[i].jit);
+        ckernel_free(&ps->plots[i].kernel);
+        tile_cache_close(&ps->plots[i].tiles);
+    }
+    free(ps->plots);
+    free(ps->buffer);
+    raster_free(&ps->image);
+    free(ps);
+}
+
+/* ____________________________________________________________________________
+
+    output_format output_format_of(const char *filename)
+
+    Chooses the format of an output file by its extension, .ppm and .pgm
+    are raster images and everything else is PostScript
+
+    Parameters:
+        filename - Name of the output file
+
+    Returns:
+        The format of the file
+   ____________________________________________________________________________
+*/
+output_format output_format_of(const char *filename) {
+
+    // sanity check
+    if(!filename) return OUTPUT_POSTSCRIPT;
+
+    const char *dot = strrchr(filename, '.');
+    if(!dot || strlen(dot) != 4) return OUTPUT_POSTSCRIPT;
+
+    char extension[4];
+    for(int i = 0; i < 3; i++) extension[i] = (char)tolower((unsigned char)dot[i + 1]);
+    extension[3] = '\0';
+
+    if(strcmp(extension, "ppm") == 0) return OUTPUT_PPM;
+    if(strcmp(extension, "pgm") == 0) return OUTPUT_PGM;
+
+    return OUTPUT_POSTSCRIPT;
+}
+
+/* ____________________________________________________________________________
+
+    postscript *create_postscript_stream(FILE *file, output_format format,
+                                         double x_min, double x_max,
+                                         double y_min, double y_max)
+
+    Creates a structure for generating a graph into an open stream, the
+    functions are added by add_plot or add_program. Raster formats are
+    drawn into an image of RASTER_SCALE pixels per PostScript point with a
+    margin for the labels and written by close_postscript.
+
+    Parameters:
+        file - The stream receiving the graph, it is closed by close_postscript
+        format - The format of the output
         x_min - Minimum X value for the graph
         x_max - Maximum X value for the graph
         y_min - Minimum Y value for the graph
@@ -33,46 +392,53 @@
         A pointer to the postscript structure, or NULL
    ____________________________________________________________________________
 */
-postscript *create_postscript(const char *filename, const char *func, double x_min, double x_max, double y_min, double y_max){
+postscript *create_postscript_stream(FILE *file, output_format format, double x_min, double x_max, double y_min, double y_max){
 
     postscript *ps;
 
     // sanity check
-    if(!filename || !func || !x_min || !x_max || !y_min || !y_max) return NULL;
+    if(!file || !x_min || !x_max || !y_min || !y_max) return NULL;
 
     // allocate memory for the PostScript structure
     ps = (postscript *)malloc(sizeof(postscript));
     if(!ps) return NULL;
+    ps->file = file;
 
-    // open file for writing
-    ps->file = fopen(filename, "w");
-    if(!ps->file) {
-        printf("H");
+    // allocate the output buffer
+    ps->buffered = 0;
+    ps->buffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+    if(!ps->buffer) {
         free(ps);
         return NULL;
     }
 
+    // allocate the image of a raster output
+    ps->format = format;
+    ps->image = NULL;
+    if(format != OUTPUT_POSTSCRIPT) {
+        ps->image = raster_create((POST_SCRIPT_WIDTH + 2 * RASTER_MARGIN) * RASTER_SCALE,
+                                  (POST_SCRIPT_HEIGHT + 2 * RASTER_MARGIN) * RASTER_SCALE);
+        if(!ps->image) {
+            free(ps->buffer);
+            free(ps);
+            return NULL;
+        }
+    }
+
     // initialize parameters
     ps->x_min = x_min;
     ps->x_max = x_max;
     ps->y_min = y_min;
     ps->y_max = y_max;
-
-    // create a queue for the postfix expression
-    ps->func = queue_create(100, sizeof(char));
-    if(!ps->func) {
-        printf("N");
-        fclose(ps->file);
-        free(ps);
-        return NULL;
-    }
-
-    // convert the function to postfix notation
-    shunting_yard(func, ps->func);
-    char x;
-    while (queue_dequeue(ps->func, &x)) {
-      printf("%c", x);
-    }
+    ps->tolerance = 0.0;
+    ps->threads = 1;
+    ps->export_target = NULL;
+    ps->derivative_steps = 0;
+    ps->draw_slopes = 0;
+    ps->scratch = NULL;
+    ps->export_precision = EXPORT_FLOAT64;
+    ps->plots = NULL;
+    ps->plot_count = 0;
 
     // calculate scaling factors
     ps->scale_x = POST_SCRIPT_WIDTH / (x_max - x_min);
@@ -83,17 +449,257 @@ postscript *create_postscript(const char *filename, const char *func, double x_m
     double y_center_offset = (y_min + y_max) / 2.0 * ps->scale_y;
 
     // write PostScript file header
-    fprintf(ps->file, "%%!PS-Adobe-3.0\n");
-    fprintf(ps->file, "%%%%Creator: C Function Graph Generator\n");
-    fprintf(ps->file, "%%%%Title: Function Graph\n");
-    fprintf(ps->file, "%%%%Pages: 1\n");
-    fprintf(ps->file, "%%%%EndComments\n");
-    fprintf(ps->file, "300 400 translate\n");
-    fprintf(ps->file, "%.2f %.2f translate\n", -x_center_offset, -y_center_offset);
+    ps_text(ps, "%!PS-Adobe-3.0\n");
+    ps_text(ps, "%%Creator: C Function Graph Generator\n");
+    ps_text(ps, "%%Title: Function Graph\n");
+    ps_text(ps, "%%Pages: 1\n");
+    ps_text(ps, "%%EndComments\n");
+    ps_text(ps, "300 400 translate\n");
+    ps_point(ps, -x_center_offset, -y_center_offset, "translate");
+
+    return ps;
+}
+
+/* ____________________________________________________________________________
+
+    postscript *create_postscript(const char *filename, const char *func,
+                                  double x_min, double x_max,
+                                  double y_min, double y_max)
+
+    Creates a structure for generating a PostScript file, or a PPM or PGM
+    image when the name has that extension
+
+    Parameters:
+        filename - Name of the file to create
+        func - Mathematical function as a string in infix notation
+        x_min - Minimum X value for the graph
+        x_max - Maximum X value for the graph
+        y_min - Minimum Y value for the graph
+        y_max - Maximum Y value for the graph
+
+    Returns:
+        A pointer to the postscript structure, or NULL
+   ____________________________________________________________________________
+*/
+postscript *create_postscript(const char *filename, const char *func, double x_min, double x_max, double y_min, double y_max){
+
+    // sanity check
+    if(!filename || !func || !x_min || !x_max || !y_min || !y_max) return NULL;
+
+    // open file for writing
+    output_format format = output_format_of(filename);
+    FILE *file = fopen(filename, format == OUTPUT_POSTSCRIPT ? "w" : "wb");
+    if(!file) {
+        printf("H");
+        return NULL;
+    }
+
+    postscript *ps = create_postscript_stream(file, format, x_min, x_max, y_min, y_max);
+    if(!ps) {
+        fclose(file);
+        return NULL;
+    }
+
+    // the first function is drawn in blue
+    color blue = {0.0, 0.0, 1.0};
+    if(!add_plot(ps, func, blue)) {
+        discard_postscript(ps);
+        return NULL;
+    }
 
     return ps;
 }
 
+/* ____________________________________________________________________________
+
+    program *compile_tokens(const queue_token *tokens, arena *scratch)
+
+    Compiles the tokens of a function into a program and optimizes it, the
+    postfix form lives in the arena and only the program is allocated
+    from the heap
+
+    Parameters:
+        tokens - The tokens of the function as read by lex_expression
+        scratch - The arena of the intermediate forms or NULL for the heap
+
+    Returns:
+        A pointer to the optimized program or NULL if it cannot be compiled
+   ____________________________________________________________________________
+*/
+program *compile_tokens(const queue_token *tokens, arena *scratch) {
+
+    // sanity check
+    if(!tokens) return NULL;
+
+    // the postfix form never has more tokens than the infix one
+    queue_token *postfix = queue_token_create(tokens->count + 1, scratch);
+    if(!postfix) return NULL;
+
+    // convert the function to postfix notation, compile and optimize it once
+    stats_mark start = stats_now();
+    int ok = shunting_yard(tokens, postfix, scratch);
+    stats_phase(PHASE_PARSE, start);
+
+    start = stats_now();
+    uint removed = 0;
+    program *p = ok ? program_create(postfix) : NULL;
+    queue_token_free(&postfix);
+    program_optimize(p, &removed, scratch);
+    stats_count(COUNTER_NODES_REMOVED, removed);
+    stats_phase(PHASE_COMPILE, start);
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    program *compile_function(const char *func, arena *scratch)
+
+    Reads a function and compiles it by compile_tokens
+
+    Parameters:
+        func - Mathematical function as a string in infix notation
+        scratch - The arena of the intermediate forms or NULL for the heap
+
+    Returns:
+        A pointer to the optimized program or NULL if it cannot be compiled
+   ____________________________________________________________________________
+*/
+program *compile_function(const char *func, arena *scratch) {
+
+    // sanity check
+    if(!func) return NULL;
+
+    queue_token *tokens = queue_token_create(strlen(func) + 1, scratch);
+    if(!tokens) return NULL;
+
+    lex_error error;
+    program *p = NULL;
+    if(lex_expression(func, tokens, &error)) p = compile_tokens(tokens, scratch);
+    queue_token_free(&tokens);
+
+    return p;
+}
+
+/* ____________________________________________________________________________
+
+    int add_program(postscript *ps, program *p, color stroke)
+
+    Adds a compiled function to the graph, the graph takes the ownership of
+    the program and frees it when it is closed
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        p - The program of the function, its native code stays borrowed
+        stroke - The color of the curve
+
+    Returns:
+        1 on success, 0 if the plot cannot be stored, the program is not
+        taken then
+   ____________________________________________________________________________
+*/
+int add_program(postscript *ps, program *p, color stroke) {
+
+    // sanity check
+    if(!ps || !p) return 0;
+
+    plot *plots = (plot *)realloc(ps->plots, sizeof(plot) * (ps->plot_count + 1));
+    if(!plots) return 0;
+    ps->plots = plots;
+
+    plot *added = &ps->plots[ps->plot_count++];
+    added->func = p;
+    added->jit = NULL;
+    added->kernel = NULL;
+    added->tiles = NULL;
+    added->stroke = stroke;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    int add_plot(postscript *ps, const char *func, color stroke)
+
+    Compiles a function in the scratch arena of the graph and adds it
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        func - Mathematical function as a string in infix notation
+        stroke - The color of the curve
+
+    Returns:
+        1 on success, 0 if the function cannot be compiled
+   ____________________________________________________________________________
+*/
+int add_plot(postscript *ps, const char *func, color stroke) {
+
+    // sanity check
+    if(!ps || !func) return 0;
+
+    program *p = compile_function(func, ps->scratch);
+    if(!p) return 0;
+
+    if(!add_program(ps, p, stroke)) {
+        program_free(&p);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    int select_backend(postscript *ps, backend b)
+
+    Selects how the functions are evaluated. The JIT backend translates
+    the programs into native code, the C backend compiles them by gcc into
+    cached shared objects. Functions for which the backend is not
+    available stay interpreted.
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        b - The requested backend
+
+    Returns:
+        1 if the requested backend is used for all functions, 0 otherwise
+   ____________________________________________________________________________
+*/
+int select_backend(postscript *ps, backend b) {
+
+    // sanity check
+    if(!ps || !ps->plots) return 0;
+
+    stats_mark start = stats_now();
+    int ok = 1;
+
+    for(size_t i = 0; i < ps->plot_count; i++) {
+        plot *pl = &ps->plots[i];
+
+        // drop the previous native code
+        pl->func->native = NULL;
+        pl->func->native_batch = NULL;
+        jit_free(&pl->jit);
+        ckernel_free(&pl->kernel);
+
+        if(b == BACKEND_JIT) {
+            pl->jit = jit_compile(pl->func);
+            if(pl->jit) pl->func->native = pl->jit->function;
+        } else if(b == BACKEND_C) {
+            pl->kernel = ckernel_load(pl->func, NULL);
+            if(pl->kernel) {
+                pl->func->native = pl->kernel->function;
+                pl->func->native_batch = pl->kernel->batch;
+            }
+        }
+
+        if(b != BACKEND_INTERPRETER && !pl->func->native) ok = 0;
+    }
+    stats_phase(PHASE_COMPILE, start);
+
+    return ok;
+}
+
 /* ____________________________________________________________________________
 
     void draw_square_axis(postscript *ps)
@@ -113,32 +719,21 @@ void draw_square_axis(postscript *ps) {
     if(!ps || !ps->file) return;
 
     // set line style
-    fprintf(ps->file, "0.7 setlinewidth\n");
-    fprintf(ps->file, "0 setgray\n");
+    ps_text(ps, "0.7 setlinewidth\n");
+    ps_text(ps, "0 setgray\n");
+    raster_pen(ps->image, 0.7 * RASTER_SCALE, 0.0, 0.0, 0.0);
 
     // draw the bottom axis
-    fprintf(ps->file, "newpath\n");
-    fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_min * ps->scale_x, ps->y_min * ps->scale_y);
-    fprintf(ps->file, "%.2f %.2f lineto\n", ps->x_max * ps->scale_x, ps->y_min * ps->scale_y);
-    fprintf(ps->file, "stroke\n");
+    ps_segment(ps, ps->x_min * ps->scale_x, ps->y_min * ps->scale_y, ps->x_max * ps->scale_x, ps->y_min * ps->scale_y);
 
     // draw the top boundary line
-    fprintf(ps->file, "newpath\n");
-    fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_min * ps->scale_x, ps->y_max * ps->scale_y);
-    fprintf(ps->file, "%.2f %.2f lineto\n", ps->x_max * ps->scale_x, ps->y_max * ps->scale_y);
-    fprintf(ps->file, "stroke\n");
+    ps_segment(ps, ps->x_min * ps->scale_x, ps->y_max * ps->scale_y, ps->x_max * ps->scale_x, ps->y_max * ps->scale_y);
 
     // draw the left boundary line
-    fprintf(ps->file, "newpath\n");
-    fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_min * ps->scale_x, ps->y_min * ps->scale_y);
-    fprintf(ps->file, "%.2f %.2f lineto\n", ps->x_min * ps->scale_x, ps->y_max * ps->scale_y);
-    fprintf(ps->file, "stroke\n");
+    ps_segment(ps, ps->x_min * ps->scale_x, ps->y_min * ps->scale_y, ps->x_min * ps->scale_x, ps->y_max * ps->scale_y);
 
     // draw the right boundary line
-    fprintf(ps->file, "newpath\n");
-    fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_max * ps->scale_x, ps->y_min * ps->scale_y);
-    fprintf(ps->file, "%.2f %.2f lineto\n", ps->x_max * ps->scale_x, ps->y_max * ps->scale_y);
-    fprintf(ps->file, "stroke\n");
+    ps_segment(ps, ps->x_max * ps->scale_x, ps->y_min * ps->scale_y, ps->x_max * ps->scale_x, ps->y_max * ps->scale_y);
 }
 
 /* ____________________________________________________________________________
@@ -160,9 +755,10 @@ void draw_ticks_and_labels(postscript *ps) {
     if(!ps || !ps->file) return;
 
     // set styles for tick marks and labels
-    fprintf(ps->file, "0.5 setlinewidth\n");
-    fprintf(ps->file, "0 setgray\n");
-    fprintf(ps->file, "/Times-Roman findfont 12 scalefont setfont\n");
+    ps_text(ps, "0.5 setlinewidth\n");
+    ps_text(ps, "0 setgray\n");
+    ps_text(ps, "/Times-Roman findfont 12 scalefont setfont\n");
+    raster_pen(ps->image, 0.5 * RASTER_SCALE, 0.0, 0.0, 0.0);
 
     // calculate grid intervals
     double y_grid_size = (ps->y_max - ps->y_min) / 8;
@@ -175,14 +771,10 @@ void draw_ticks_and_labels(postscript *ps) {
         double y_pos = y * ps->scale_y;
 
         // draw tick mark
-        fprintf(ps->file, "newpath\n");
-        fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_min * ps->scale_x, y_pos);
-        fprintf(ps->file, "%.2f %.2f lineto\n", ps->x_max * ps->scale_x, y_pos);
-        fprintf(ps->file, "stroke\n");
+        ps_segment(ps, ps->x_min * ps->scale_x, y_pos, ps->x_max * ps->scale_x, y_pos);
 
         // draw label
-        fprintf(ps->file, "%.2f %.2f moveto\n", ps->x_min * ps->scale_x - 20, y_pos - 3);
-        fprintf(ps->file, "(%.1f) show\n", y);
+        ps_label(ps, ps->x_min * ps->scale_x - 20, y_pos - 3, y);
     }
 
     // draw tick marks and labels on the X axis
@@ -192,14 +784,10 @@ void draw_ticks_and_labels(postscript *ps) {
        double x_pos = x * ps->scale_x;
 
         // draw tick mark
-        fprintf(ps->file, "newpath\n");
-        fprintf(ps->file, "%.2f %.2f moveto\n", x_pos, ps->y_min * ps->scale_y);
-        fprintf(ps->file, "%.2f %.2f lineto\n", x_pos, ps->y_max * ps->scale_y);
-        fprintf(ps->file, "stroke\n");
+        ps_segment(ps, x_pos, ps->y_min * ps->scale_y, x_pos, ps->y_max * ps->scale_y);
 
         // draw label
-        fprintf(ps->file, "%.2f %.2f moveto\n", x_pos - 10, ps->y_min * ps->scale_y - 20);
-        fprintf(ps->file, "(%.1f) show\n", x);
+        ps_label(ps, x_pos - 10, ps->y_min * ps->scale_y - 20, x);
     }
 }
 
@@ -207,38 +795,68 @@ void draw_ticks_and_labels(postscript *ps) {
 
 /* ____________________________________________________________________________
 
-    void draw_graph(postscript *ps)
+    static void ps_color(postscript *ps, color c)
 
-    Draws the graph of a mathematical function on the PostScript canvas.
+    Sets the color of the following paths
 
     Parameters:
-        ps - A pointer to the PostScript structure.
+        ps - A pointer to the PostScript structure
+        c - The color
 
     Returns:
-        Nothing. The graph is written directly to the PostScript file.
+        Nothing.
    ____________________________________________________________________________
 */
-void draw_graph(postscript *ps) {
+static void ps_color(postscript *ps, color c) {
+
+    double components[3] = {c.r, c.g, c.b};
+    char text[OUTPUT_MAX_ITEM];
+
+    for(int i = 0; i < 3; i++) {
+        // three decimals without trailing zeros
+        size_t length = format_fixed(text, components[i], 3);
+        while(length > 1 && text[length - 1] == '0') length--;
+        if(text[length - 1] == '.') length--;
+        text[length++] = ' ';
+        text[length] = '\0';
+        ps_text(ps, text);
+    }
+    ps_text(ps, "setrgbcolor\n");
+}
 
-    // sanity check
-    if(!ps) return;
+/* ____________________________________________________________________________
 
-    // set the line style for the graph
-    fprintf(ps->file, "1 setlinewidth\n");
-    fprintf(ps->file, "0 0 1 setrgbcolor\n");
-    fprintf(ps->file, "newpath\n");
+    static void draw_curve(postscript *ps, const viewport *v, curve *c, color stroke)
+
+    Writes the path of one sampled curve, the pen is lifted wherever the
+    curve leaves the viewport or its domain
+
+    Parameters:
+        ps - A pointer to the PostScript structure
+        v - A pointer to the viewport
+        c - A pointer to the sampled curve, NULL draws an empty path
+        stroke - The color of the curve
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void draw_curve(postscript *ps, const viewport *v, curve *c, color stroke) {
 
-    int pen_down = 1;
+    ps_color(ps, stroke);
+    ps_text(ps, "newpath\n");
+    raster_pen(ps->image, RASTER_SCALE, stroke.r, stroke.g, stroke.b);
 
-    // iterate through x values in the range
-    for(double x = ps->x_min; x <= ps->x_max; x += 0.001) {
+    int pen_down = 0;
+    double previous_x = 0.0, previous_y = 0.0;
 
-        // evaluate the function for the current x
-        double y = evaluate_postfix_expression(ps->func, x);
-		printf("%.2f %.2f lineto\n", x, y);
+    for(size_t i = 0; c && i < c->count; i++) {
+        double x = c->x[i];
+        double y = c->y[i];
 
         // check if y is within the allowed range
-        if(y < ps->y_min || y > ps->y_max || isnan(y)) {
+        if(!sample_visible(v, y)) {
+            if(pen_down) stats_count(COUNTER_PEN_UPS, 1);
             pen_down = 0;
             continue;
         }
@@ -249,24 +867,145 @@ void draw_graph(postscript *ps) {
 
         // if the pen is not down move to the current point
         if(!pen_down) {
-            fprintf(ps->file, "%.2lf %.2lf moveto\n", x_screen, y_screen);
+            ps_point(ps, x_screen, y_screen, "moveto");
             pen_down = 1;
 
         // if the pen is down continue drawing the line
         } else {
-            if(x == ps->x_min)
-                fprintf(ps->file, "%.2lf %.2lf moveto\n", x_screen, y_screen);
-            else
-                fprintf(ps->file, "%.2lf %.2lf lineto\n", x_screen, y_screen);
+            ps_point(ps, x_screen, y_screen, "lineto");
+            if(ps->image) {
+                double px0, py0, px1, py1;
+                ps_pixel(ps, previous_x, previous_y, &px0, &py0);
+                ps_pixel(ps, x_screen, y_screen, &px1, &py1);
+                raster_line(ps->image, px0, py0, px1, py1);
+            }
         }
+        previous_x = x_screen;
+        previous_y = y_screen;
+    }
+
+    // finish drawing the curve
+    ps_text(ps, "stroke\n");
+    raster_stroke(ps->image);
+}
+
+/* ____________________________________________________________________________
 
+    int draw_graph(postscript *ps)
 
+    Draws the graphs of all functions on the PostScript canvas. The
+    functions are sampled together over a shared X grid, every one is
+    drawn as its own path in its own color. The samples are exported
+    before the simplification when an export target is set. The
+    derivatives are drawn below the functions in lighter colors when
+    requested, they come from the evaluation on dual numbers.
 
+    Parameters:
+        ps - A pointer to the PostScript structure.
 
+    Returns:
+        GRAPH_DRAWN on success, GRAPH_NO_MEMORY if the functions cannot be
+        sampled, nothing is drawn then, GRAPH_NOT_EXPORTED if the samples
+        cannot be exported. The graph is written directly to the
+        PostScript file.
+   ____________________________________________________________________________
+*/
+graph_result draw_graph(postscript *ps) {
 
+    // sanity check
+    if(!ps || ps->plot_count == 0) return GRAPH_DRAWN;
+
+    size_t count = ps->plot_count;
+    program **programs = (program **)arena_alloc(ps->scratch, sizeof(program *) * count);
+    tile_cache **tiles = (tile_cache **)arena_alloc(ps->scratch, sizeof(tile_cache *) * count);
+    curve **curves = (curve **)arena_calloc(ps->scratch, count, sizeof(curve *));
+    curve **slopes = ps->draw_slopes ? (curve **)arena_calloc(ps->scratch, count, sizeof(curve *)) : NULL;
+    unsigned long long before = 0, after = 0, hits_before = 0, hits_after = 0;
+    for(size_t k = 0; programs && tiles && k < count; k++) {
+        programs[k] = ps->plots[k].func;
+        tiles[k] = ps->plots[k].tiles;
+        before += programs[k]->evaluations;
+        hits_before += tile_cache_hits(tiles[k]);
+    }
+
+    // sample the functions adaptively over the visible range
+    stats_mark start = stats_now();
+    viewport v = {ps->x_min, ps->x_max, ps->y_min, ps->y_max, ps->scale_x, ps->scale_y};
+    int sampled = 0;
+    if(programs && tiles && curves && ps->derivative_steps) {
+        sampled = sample_derivative(programs, count, &v, curves, slopes);
+    } else if(programs && tiles && curves) {
+        sampled = sample_functions(programs, tiles, count, &v, ps->threads, curves, ps->scratch);
+        for(size_t k = 0; sampled && slopes && k < count; k++) {
+            slopes[k] = sample_slopes(programs[k], curves[k]);
+            if(!slopes[k]) sampled = 0;
+        }
+    }
+    for(size_t k = 0; programs && tiles && k < count; k++) {
+        after += programs[k]->evaluations;
+        hits_after += tile_cache_hits(tiles[k]);
+    }
+    stats_count(COUNTER_EVALUATIONS, after - before);
+    stats_count(COUNTER_CACHED_SAMPLES, hits_after - hits_before);
+    stats_phase(PHASE_SAMPLE, start);
+
+    // a graph missing some of its samples is not drawn at all
+    if(!sampled) {
+        for(size_t k = 0; curves && k < count; k++) curve_free(&curves[k]);
+        for(size_t k = 0; slopes && k < count; k++) curve_free(&slopes[k]);
+        arena_release(ps->scratch, programs);
+        arena_release(ps->scratch, tiles);
+        arena_release(ps->scratch, curves);
+        arena_release(ps->scratch, slopes);
+        return GRAPH_NO_MEMORY;
+    }
+
+    // count the samples outside of the domain or the viewport
+    for(size_t k = 0; curves && k < count; k++) {
+        for(size_t i = 0; curves[k] && i < curves[k]->count; i++) {
+            if(isnan(curves[k]->y[i])) stats_count(COUNTER_NAN, 1);
+            else if(!sample_visible(&v, curves[k]->y[i])) stats_count(COUNTER_OUT_OF_RANGE, 1);
+        }
+    }
+
+    // export the samples for other processes
+    int exported = 1;
+    if(ps->export_target) {
+        start = stats_now();
+        exported = curves && export_samples(ps->export_target, ps->export_precision, &v, curves, count);
+        if(exported) stats_count(COUNTER_BYTES, export_size(curves, count, ps->export_precision));
+        stats_phase(PHASE_EMIT, start);
+    }
+
+    // drop the samples which do not change the paths visibly
+    start = stats_now();
+    for(size_t k = 0; curves && ps->tolerance > 0.0 && k < count; k++) {
+        if(curves[k]) curve_simplify(curves[k], &v, ps->tolerance, ps->scratch);
+        if(slopes && slopes[k]) curve_simplify(slopes[k], &v, ps->tolerance, ps->scratch);
+    }
+    stats_phase(PHASE_SIMPLIFY, start);
+
+    // set the line style for the graph, then draw one path per function
+    start = stats_now();
+    ps_text(ps, "1 setlinewidth\n");
+    for(size_t k = 0; slopes && k < count; k++) {
+        color stroke = ps->plots[k].stroke;
+        color light = {0.5 + 0.5 * stroke.r, 0.5 + 0.5 * stroke.g, 0.5 + 0.5 * stroke.b};
+        draw_curve(ps, &v, slopes[k], light);
+        curve_free(&slopes[k]);
+    }
+    for(size_t k = 0; k < count; k++) {
+        draw_curve(ps, &v, curves ? curves[k] : NULL, ps->plots[k].stroke);
+        if(curves) curve_free(&curves[k]);
     }
-    // finish drawing the graph
-    fprintf(ps->file, "stroke\n");
+    stats_phase(PHASE_EMIT, start);
+
+    arena_release(ps->scratch, programs);
+    arena_release(ps->scratch, tiles);
+    arena_release(ps->scratch, curves);
+    arena_release(ps->scratch, slopes);
+
+    return exported ? GRAPH_DRAWN : GRAPH_NOT_EXPORTED;
 }
 
 /* ____________________________________________________________________________
@@ -287,14 +1026,16 @@ void close_postscript(postscript *ps) {
     // sanity check
     if(!ps) return;
 
+    // write the image of a raster output
+    if(ps->file && ps->image) {
+        stats_count(COUNTER_BYTES, raster_write(ps->image, ps->file, ps->format == OUTPUT_PGM));
+
     // closing PostScript file
-    if(ps->file) {
-        fprintf(ps->file, "showpage\n");
-        fclose(ps->file);
+    } else if(ps->file) {
+        ps_text(ps, "showpage\n");
+        ps_flush(ps);
     }
 
-    // free memory
-    queue_free(&ps->func);
-    free(ps);
+    discard_postscript(ps);
 }
 
@@ -2,7 +2,13 @@
 #define POSTSCRIPT_H
 
 #include <stdio.h>
-#include "queue.h"
+#include "postfixmath.h"
+#include "jit.h"
+#include "ckernel.h"
+#include "tilecache.h"
+#include "raster.h"
+#include "export.h"
+#include "arena.h"
 
 
 /* ____________________________________________________________________________
@@ -11,25 +17,90 @@
    ____________________________________________________________________________
 */
 
+// evaluation backends of the function
+typedef enum {
+    BACKEND_INTERPRETER,
+    BACKEND_JIT,
+    BACKEND_C
+} backend;
+
+// formats of the output file, chosen by its extension
+typedef enum {
+    OUTPUT_POSTSCRIPT,
+    OUTPUT_PPM,
+    OUTPUT_PGM
+} output_format;
+
+// results of draw_graph
+typedef enum {
+    GRAPH_DRAWN,
+    GRAPH_NO_MEMORY,        // the functions cannot be sampled
+    GRAPH_NOT_EXPORTED      // the samples cannot be exported
+} graph_result;
+
+// color of a curve, components between 0 and 1
+typedef struct {
+    double r;
+    double g;
+    double b;
+} color;
+
+// a function drawn into the graph
+typedef struct {
+    program *func;
+    jit_program *jit;   // native code of func, NULL when interpreted
+    ckernel *kernel;    // compiled C kernel of func, NULL when not used
+    tile_cache *tiles;  // cached samples of func, NULL when not used
+    color stroke;
+} plot;
+
 typedef struct {
     FILE *file;
-    queue *func;
+    char *buffer;       // output waiting to be written to the file
+    output_format format;
+    raster *image;      // pixels of a PPM or PGM output, NULL for PostScript
+    size_t buffered;
+    plot *plots;        // the functions, drawn in this order
+    size_t plot_count;
     double x_min;
     double x_max;
     double y_min;
     double y_max;
     double scale_x;
     double scale_y;
+    double tolerance;   // tolerance of the path simplification, 0 disables it
+    int threads;        // number of threads sampling the graph
+    const char *export_target;      // file or shared memory receiving the samples, or NULL
+    export_type export_precision;
+    int derivative_steps;   // samples by steps following the derivative instead of the subdivision
+    int draw_slopes;        // draws the derivatives of the functions
+    arena *scratch;         // memory of the parsing and sampling, NULL for the heap
 } postscript;
 
+output_format output_format_of(const char *filename);
+
+postscript *create_postscript_stream(FILE *file, output_format format, double x_min, double x_max, double y_min, double y_max);
+
 postscript *create_postscript(const char *filename, const char *func, double x_min, double x_max, double y_min, double y_max);
 
+program *compile_tokens(const queue_token *tokens, arena *scratch);
+
+program *compile_function(const char *func, arena *scratch);
+
+int add_program(postscript *ps, program *p, color stroke);
+
+int add_plot(postscript *ps, const char *func, color stroke);
+
+int select_backend(postscript *ps, backend b);
+
 void draw_square_axis(postscript *ps);
 
 void draw_ticks_and_labels(postscript *ps);
 
-void draw_graph(postscript *ps);
+graph_result draw_graph(postscript *ps);
 
 void close_postscript(postscript *ps);
 
+size_t format_fixed(char *out, double value, int decimals);
+
 #endif // POSTSCRIPT_H
@@ -1,33 +1,125 @@
 #ifndef QUEUE_H
 #define QUEUE_H
 
-/* ____________________________________________________________________________
-
-    Function Prototypes
-   ____________________________________________________________________________
-*/
+#include <stddef.h>
+#include <string.h>
+#include "arena.h"
 
 typedef unsigned int uint;
 
-typedef struct {
-    void *items;
-    int first;
-    int last;
-    uint size;
-    uint item_size;
-    int count;
-    void (*item_free)(void *);
-} queue;
+/* ____________________________________________________________________________
 
-queue *queue_create(uint size, uint item_size);
+    Typed Queues
 
-int queue_enqueue(queue *q, void *item);
+    QUEUE_DEFINE(name, type) defines the queue type name holding items of
+    type in a circular buffer and its functions, every function starts
+    with the name:
 
-int queue_dequeue(queue *q, void *item);
+        name *name_create(size_t capacity, arena *scratch)
+        int name_enqueue(name *q, type item)
+        int name_dequeue(name *q, type *item)
+        int name_get(const name *q, size_t index, type *item)
+        name *name_copy(const name *q)
+        void name_free(name **q)
 
-void queue_free(queue **q);
+    Items are copied by assignment. A full queue doubles its capacity, so
+    an enqueue fails only when memory allocation fails. name_get reads the
+    items from the front without removing them. A queue of an arena, and
+    its copies, stay in the arena until it is reset, NULL allocates from
+    the heap.
 
-queue *queue_copy(queue *q);
+        QUEUE_DEFINE(queue_token, token)
+   ____________________________________________________________________________
+*/
 
+#define QUEUE_DEFINE(name, type)                                                \
+                                                                                \
+typedef struct {                                                                \
+    type *items;                                                                \
+    size_t first;       /* position of the front in the circular buffer */     \
+    size_t count;                                                               \
+    size_t capacity;                                                            \
+    arena *scratch;     /* the arena of the queue or NULL for the heap */       \
+} name;                                                                         \
+                                                                                \
+static inline name *name##_create(size_t capacity, arena *scratch) {            \
+                                                                                \
+    name *q = (name *)arena_alloc(scratch, sizeof(name));                       \
+    if(!q) return NULL;                                                         \
+                                                                                \
+    q->first = 0;                                                               \
+    q->count = 0;                                                               \
+    q->capacity = capacity ? capacity : 1;                                      \
+    q->scratch = scratch;                                                       \
+    q->items = (type *)arena_alloc(scratch, sizeof(type) * q->capacity);        \
+    if(!q->items) {                                                             \
+        arena_release(scratch, q);                                              \
+        return NULL;                                                            \
+    }                                                                           \
+                                                                                \
+    return q;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_enqueue(name *q, type item) {                          \
+                                                                                \
+    if(!q) return 0;                                                            \
+                                                                                \
+    /* the wrapped front part moves behind the old end */                       \
+    if(q->count == q->capacity) {                                               \
+        if(q->capacity > (size_t)-1 / (2 * sizeof(type))) return 0;             \
+        type *items = (type *)arena_grow(q->scratch, q->items,                  \
+                                         sizeof(type) * q->capacity,            \
+                                         sizeof(type) * 2 * q->capacity);       \
+        if(!items) return 0;                                                    \
+        memcpy(items + q->capacity, items, sizeof(type) * q->first);            \
+        q->items = items;                                                       \
+        q->capacity *= 2;                                                       \
+    }                                                                           \
+                                                                                \
+    q->items[(q->first + q->count++) % q->capacity] = item;                     \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_dequeue(name *q, type *item) {                         \
+                                                                                \
+    if(!q || !item || q->count == 0) return 0;                                  \
+                                                                                \
+    *item = q->items[q->first];                                                 \
+    q->first = (q->first + 1) % q->capacity;                                    \
+    q->count--;                                                                 \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_get(const name *q, size_t index, type *item) {         \
+                                                                                \
+    if(!q || !item || index >= q->count) return 0;                              \
+                                                                                \
+    *item = q->items[(q->first + index) % q->capacity];                         \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline name *name##_copy(const name *q) {                                \
+                                                                                \
+    if(!q) return NULL;                                                         \
+                                                                                \
+    name *copy = name##_create(q->count, q->scratch);                           \
+    if(!copy) return NULL;                                                      \
+                                                                                \
+    for(size_t i = 0; i < q->count; i++) {                                      \
+        copy->items[i] = q->items[(q->first + i) % q->capacity];                \
+    }                                                                           \
+    copy->count = q->count;                                                     \
+                                                                                \
+    return copy;                                                                \
+}                                                                               \
+                                                                                \
+static inline void name##_free(name **q) {                                      \
+                                                                                \
+    if(!q || !*q) return;                                                       \
+                                                                                \
+    arena_release((*q)->scratch, (*q)->items);                                  \
+    arena_release((*q)->scratch, *q);                                           \
+    *q = NULL;                                                                  \
+}
 
 #endif //QUEUE_H
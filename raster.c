@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "raster.h"
+
+// constants
+#define GLYPH_WIDTH 5
+#define GLYPH_HEIGHT 7
+#define GLYPH_ADVANCE 6
+
+// glyphs of the labels, rows from the top, the highest of 5 bits is the left column
+static const char glyph_chars[] = "0123456789-.";
+static const unsigned char glyphs[][GLYPH_HEIGHT] = {
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e},
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e},
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e},
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08},
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c},
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}
+};
+
+/* ____________________________________________________________________________
+
+    raster *raster_create(int width, int height)
+
+    Creates a white image
+
+    Parameters:
+        width - The width in pixels
+        height - The height in pixels
+
+    Returns:
+        A pointer to the image or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+raster *raster_create(int width, int height) {
+
+    // sanity check
+    if(width <= 0 || height <= 0) return NULL;
+
+    raster *r = (raster *)malloc(sizeof(raster));
+    if(!r) return NULL;
+
+    size_t pixels = (size_t)width * (size_t)height;
+    r->pixels = (unsigned char *)malloc(3 * pixels);
+    r->coverage = (unsigned char *)calloc(pixels, 1);
+    if(!r->pixels || !r->coverage) {
+        raster_free(&r);
+        return NULL;
+    }
+    memset(r->pixels, 255, 3 * pixels);
+
+    r->width = width;
+    r->height = height;
+    r->min_x = width;
+    r->min_y = height;
+    r->max_x = -1;
+    r->max_y = -1;
+    raster_pen(r, 1.0, 0.0, 0.0, 0.0);
+
+    return r;
+}
+
+/* ____________________________________________________________________________
+
+    void raster_pen(raster *r, double width, double red, double green, double blue)
+
+    Sets the width and color of the following lines and text
+
+    Parameters:
+        r - A pointer to the image
+        width - The width of the lines in pixels
+        red, green, blue - The components of the color between 0 and 1
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void raster_pen(raster *r, double width, double red, double green, double blue) {
+
+    // sanity check
+    if(!r) return;
+
+    double components[3] = {red, green, blue};
+    for(int i = 0; i < 3; i++) {
+        double c = components[i] < 0.0 ? 0.0 : components[i] > 1.0 ? 1.0 : components[i];
+        r->pen[i] = (unsigned char)lround(c * 255.0);
+    }
+    r->pen_width = width;
+}
+
+/* ____________________________________________________________________________
+
+    static int clamp_index(double value, int limit)
+
+    Converts a coordinate to an index between -1 and limit, so values far
+    outside of the image do not overflow
+
+    Parameters:
+        value - The coordinate
+        limit - The number of pixels
+
+    Returns:
+        The clamped index
+   ____________________________________________________________________________
+*/
+static int clamp_index(double value, int limit) {
+
+    if(!(value > -1.0)) return -1;
+    if(value > limit) return limit;
+
+    return (int)value;
+}
+
+/* ____________________________________________________________________________
+
+    void raster_line(raster *r, double x0, double y0, double x1, double y1)
+
+    Adds a line to the coverage of the current stroke. The line is scanned
+    row by row, every row visits only the span where the line can reach
+    and every pixel is covered by its distance from the line. Lines
+    thinner than a pixel keep the footprint of one pixel and get lighter.
+
+    Parameters:
+        r - A pointer to the image
+        x0, y0 - The start of the line in pixels, y grows downwards
+        x1, y1 - The end of the line
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void raster_line(raster *r, double x0, double y0, double x1, double y1) {
+
+    // sanity check
+    if(!r || !isfinite(x0) || !isfinite(y0) || !isfinite(x1) || !isfinite(y1)) return;
+
+    double width = r->pen_width > 1.0 ? r->pen_width : 1.0;
+    double intensity = r->pen_width < 1.0 ? (r->pen_width > 0.0 ? r->pen_width : 0.0) : 1.0;
+    double reach = 0.5 * width + 0.5;
+
+    double dx = x1 - x0, dy = y1 - y0;
+    double length2 = dx * dx + dy * dy;
+    double left = fmin(x0, x1) - reach, right = fmax(x0, x1) + reach;
+
+    int row_first = clamp_index(floor(fmin(y0, y1) - reach), r->height);
+    int row_last = clamp_index(ceil(fmax(y0, y1) + reach), r->height);
+    if(row_first < 0) row_first = 0;
+    if(row_last > r->height - 1) row_last = r->height - 1;
+
+    for(int py = row_first; py <= row_last; py++) {
+        double cy = py + 0.5;
+
+        // the span of the row within the reach of the infinite line
+        double span_left = left, span_right = right;
+        if(fabs(dy) > 1e-9) {
+            double center = x0 + (cy - y0) * dx / dy;
+            double half = reach * sqrt(length2) / fabs(dy);
+            span_left = fmax(span_left, center - half);
+            span_right = fmin(span_right, center + half);
+        }
+
+        int column_first = clamp_index(floor(span_left), r->width);
+        int column_last = clamp_index(ceil(span_right), r->width);
+        if(column_first < 0) column_first = 0;
+        if(column_last > r->width - 1) column_last = r->width - 1;
+
+        for(int px = column_first; px <= column_last; px++) {
+            double cx = px + 0.5;
+
+            // distance of the pixel center from the segment
+            double t = length2 > 0.0 ? ((cx - x0) * dx + (cy - y0) * dy) / length2 : 0.0;
+            t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+            double ex = cx - (x0 + t * dx), ey = cy - (y0 + t * dy);
+            double d = sqrt(ex * ex + ey * ey);
+
+            double c = reach - d;
+            if(c <= 0.0) continue;
+            if(c > 1.0) c = 1.0;
+
+            unsigned char value = (unsigned char)lround(c * intensity * 255.0);
+            unsigned char *mask = &r->coverage[(size_t)py * r->width + px];
+            if(value > *mask) *mask = value;
+        }
+
+        if(column_first <= column_last) {
+            if(column_first < r->min_x) r->min_x = column_first;
+            if(column_last > r->max_x) r->max_x = column_last;
+            if(py < r->min_y) r->min_y = py;
+            if(py > r->max_y) r->max_y = py;
+        }
+    }
+}
+
+/* ____________________________________________________________________________
+
+    void raster_stroke(raster *r)
+
+    Paints the coverage of the current stroke by the pen and clears it
+
+    Parameters:
+        r - A pointer to the image
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void raster_stroke(raster *r) {
+
+    // sanity check
+    if(!r) return;
+
+    for(int y = r->min_y; y <= r->max_y; y++) {
+        for(int x = r->min_x; x <= r->max_x; x++) {
+            size_t i = (size_t)y * r->width + x;
+            unsigned int a = r->coverage[i];
+            if(a == 0) continue;
+
+            unsigned char *p = &r->pixels[3 * i];
+            for(int k = 0; k < 3; k++) p[k] = (unsigned char)((p[k] * (255 - a) + r->pen[k] * a + 127) / 255);
+            r->coverage[i] = 0;
+        }
+    }
+
+    r->min_x = r->width;
+    r->min_y = r->height;
+    r->max_x = -1;
+    r->max_y = -1;
+}
+
+/* ____________________________________________________________________________
+
+    void raster_text(raster *r, double x, double y, int size, const char *text)
+
+    Draws a text by the built-in font of digits, minus and decimal point,
+    other characters are skipped
+
+    Parameters:
+        r - A pointer to the image
+        x, y - The left end of the baseline in pixels
+        size - The size of a dot of the glyphs in pixels
+        text - The text
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void raster_text(raster *r, double x, double y, int size, const char *text) {
+
+    // sanity check
+    if(!r || !text || size < 1) return;
+
+    int left = (int)lround(x);
+    int top = (int)lround(y) - GLYPH_HEIGHT * size;
+
+    for(; *text; text++, left += GLYPH_ADVANCE * size) {
+        const char *found = strchr(glyph_chars, *text);
+        if(!found) continue;
+        const unsigned char *glyph = glyphs[found - glyph_chars];
+
+        for(int row = 0; row < GLYPH_HEIGHT * size; row++) {
+            int py = top + row;
+            if(py < 0 || py >= r->height) continue;
+            for(int column = 0; column < GLYPH_WIDTH * size; column++) {
+                int px = left + column;
+                if(px < 0 || px >= r->width) continue;
+                if(!(glyph[row / size] & (0x10 >> (column / size)))) continue;
+                memcpy(&r->pixels[3 * ((size_t)py * r->width + px)], r->pen, 3);
+            }
+        }
+    }
+}
+
+/* ____________________________________________________________________________
+
+    size_t raster_write(const raster *r, FILE *file, int gray)
+
+    Writes the image as a binary PPM, or as a binary PGM of the luma of
+    the pixels
+
+    Parameters:
+        r - A pointer to the image
+        file - The output stream
+        gray - 1 for PGM, 0 for PPM
+
+    Returns:
+        The number of bytes written, 0 if writing fails
+   ____________________________________________________________________________
+*/
+size_t raster_write(const raster *r, FILE *file, int gray) {
+
+    // sanity check
+    if(!r || !file) return 0;
+
+    int header = fprintf(file, "%s\n%d %d\n255\n", gray ? "P5" : "P6", r->width, r->height);
+    if(header < 0) return 0;
+
+    size_t pixels = (size_t)r->width * r->height;
+    size_t written = (size_t)header;
+
+    if(!gray) {
+        if(fwrite(r->pixels, 3, pixels, file) != pixels) return 0;
+        return written + 3 * pixels;
+    }
+
+    unsigned char *row = (unsigned char *)malloc(r->width);
+    if(!row) return 0;
+    for(int y = 0; y < r->height; y++) {
+        const unsigned char *p = &r->pixels[3 * (size_t)y * r->width];
+        for(int x = 0; x < r->width; x++, p += 3) {
+            row[x] = (unsigned char)((299 * p[0] + 587 * p[1] + 114 * p[2] + 500) / 1000);
+        }
+        if(fwrite(row, 1, r->width, file) != (size_t)r->width) {
+            free(row);
+            return 0;
+        }
+    }
+    free(row);
+
+    return written + pixels;
+}
+
+/* ____________________________________________________________________________
+
+    void raster_free(raster **r)
+
+    Frees the memory allocated for the image
+
+    Parameters:
+        r - A double pointer to the image to be freed
+
+    Returns:
+        Nothing. The image pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void raster_free(raster **r) {
+
+    // sanity check
+    if(!r || !*r) return;
+
+    free((*r)->pixels);
+    free((*r)->coverage);
+    free(*r);
+    *r = NULL;
+}
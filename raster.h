@@ -0,0 +1,49 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdio.h>
+
+/* ____________________________________________________________________________
+
+    Raster Image
+
+    An RGB pixel buffer drawn by anti-aliased strokes. The lines of a
+    stroke collect their coverage in a mask which is painted at once by
+    raster_stroke, so joints of a path are not painted twice.
+   ____________________________________________________________________________
+*/
+
+typedef struct {
+    unsigned char *pixels;      // RGB rows from the top, white initially
+    unsigned char *coverage;    // coverage of the current stroke
+    int width;
+    int height;
+    int min_x;                  // box of the coverage of the current stroke
+    int min_y;
+    int max_x;
+    int max_y;
+    double pen_width;           // width of the lines in pixels
+    unsigned char pen[3];       // color of the lines and text
+} raster;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+raster *raster_create(int width, int height);
+
+void raster_pen(raster *r, double width, double red, double green, double blue);
+
+void raster_line(raster *r, double x0, double y0, double x1, double y1);
+
+void raster_stroke(raster *r);
+
+void raster_text(raster *r, double x, double y, int size, const char *text);
+
+size_t raster_write(const raster *r, FILE *file, int gray);
+
+void raster_free(raster **r);
+
+#endif //RASTER_H
@@ -0,0 +1,404 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "expression.h"
+#include "render.h"
+#include "stats.h"
+
+// colors of the functions without an explicit color, the first one is blue
+static const color palette[] = {{0.0, 0.0, 1.0}, {1.0, 0.0, 0.0}, {0.0, 0.6, 0.0},
+                                {0.8, 0.0, 0.8}, {1.0, 0.5, 0.0}, {0.0, 0.7, 0.7},
+                                {0.6, 0.3, 0.0}, {0.4, 0.4, 0.4}};
+
+/* ____________________________________________________________________________
+
+    int split_functions(char *list, char **functions, color *colors)
+
+    Splits the list of functions separated by ';', every function may be
+    followed by its color as @rrggbb in hexadecimal, the others get the
+    colors of the palette
+
+    Parameters:
+        list - The list of functions, it is modified in place
+        functions - An array of MAX_FUNCTIONS receiving the functions
+        colors - An array of MAX_FUNCTIONS receiving their colors
+
+    Returns:
+        The number of functions or 0 if the list is invalid
+   ____________________________________________________________________________
+*/
+int split_functions(char *list, char **functions, color *colors) {
+
+    // sanity check
+    if(!list) return 0;
+
+    int count = 0;
+    char *next = list;
+    while(next) {
+        if(count == MAX_FUNCTIONS) return 0;
+
+        char *current = next;
+        next = strchr(current, ';');
+        if(next) *next++ = '\0';
+
+        colors[count] = palette[count % (sizeof(palette) / sizeof(palette[0]))];
+
+        // explicit color
+        char *at = strchr(current, '@');
+        if(at) {
+            unsigned int rgb;
+            char end;
+            *at = '\0';
+            if(strlen(at + 1) != 6 || sscanf(at + 1, "%6x%c", &rgb, &end) != 1) return 0;
+            colors[count].r = ((rgb >> 16) & 0xff) / 255.0;
+            colors[count].g = ((rgb >> 8) & 0xff) / 255.0;
+            colors[count].b = (rgb & 0xff) / 255.0;
+        }
+
+        functions[count++] = current;
+    }
+
+    return count;
+}
+
+/* ____________________________________________________________________________
+
+    static void release_programs(const render_options *o, char **functions,
+                                 program **programs, int count)
+
+    Frees the programs of the first functions which the graph has not
+    taken, then unpins their cache entries
+
+    Parameters:
+        o - The options of the rendering
+        functions - The normalized functions
+        programs - The programs of the functions, NULL for the taken ones
+        count - The number of functions compiled or taken from the cache
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void release_programs(const render_options *o, char **functions, program **programs, int count) {
+
+    for(int i = 0; i < count; i++) program_free(&programs[i]);
+    for(int i = 0; o->cache && i < count; i++) expression_cache_release(o->cache, functions[i]);
+}
+
+/* ____________________________________________________________________________
+
+    static int render_functions(char *list, const char *outfile, FILE *stream,
+                                const char *limits, const render_options *o,
+                                arena *scratch, char *error)
+
+    Renders the functions of the list, see render_graph. The tokens of the
+    functions, the parsing and the sampling take their memory from the
+    arena, so nothing of it has to be freed on the way out.
+
+    Parameters:
+        list - The functions separated by ';', it is modified in place
+        outfile - The name of the output file
+        stream - An open stream receiving the graph instead of the file or
+                 NULL, it is closed by the render
+        limits - The limits in the format x_min:x_max:y_min:y_max or NULL
+        o - The options of the rendering
+        scratch - The arena of the render
+        error - A buffer of ERROR_SIZE receiving the message of a failure
+
+    Returns:
+        SUCCESS (0) or the error code of the failure
+   ____________________________________________________________________________
+*/
+static int render_functions(char *list, const char *outfile, FILE *stream, const char *limits,
+                            const render_options *o, arena *scratch, char *error) {
+
+    // split the functions
+    char *functions[MAX_FUNCTIONS];
+    color colors[MAX_FUNCTIONS];
+    int function_count = split_functions(list, functions, colors);
+    if(function_count == 0) {
+        if(stream) fclose(stream);
+        snprintf(error, ERROR_SIZE, "Invalid list of functions or colors.");
+        return ERR_INVALID_FUNCTION;
+    }
+
+    // read the tokens of the functions in one pass, the normalized form
+    // names the functions from now on
+    queue_token *tokens[MAX_FUNCTIONS];
+    stats_mark start = stats_now();
+    for(int i = 0; i < function_count; i++) {
+        lex_error lexed;
+        tokens[i] = queue_token_create(strlen(functions[i]) + 1, scratch);
+        if(!tokens[i] || !lex_expression(functions[i], tokens[i], &lexed)) {
+            if(stream) fclose(stream);
+            if(tokens[i] && lexed.message) {
+                snprintf(error, ERROR_SIZE, "The function contains %s at position %u.",
+                         lexed.message, lexed.position + 1);
+            } else {
+                snprintf(error, ERROR_SIZE, "Out of memory.");
+            }
+            return ERR_INVALID_FUNCTION;
+        }
+
+        functions[i] = format_tokens(functions[i], tokens[i], scratch);
+        if(!functions[i]) {
+            if(stream) fclose(stream);
+            snprintf(error, ERROR_SIZE, "Out of memory.");
+            return ERR_INVALID_FUNCTION;
+        }
+    }
+    stats_phase(PHASE_PREPROCESS, start);
+
+
+    if(o->verbose) {
+        for(int i = 0; i < function_count; i++) printf("Function %s\n", functions[i]);
+        printf("Outfile %s\n", outfile);
+        printf("Limits %s\n", limits);
+    }
+
+    start = stats_now();
+    for(int i = 0; i < function_count; i++) {
+        // check if the function contains the variable x
+        if(!tokens_contain_x(tokens[i])) {
+            if(stream) fclose(stream);
+            snprintf(error, ERROR_SIZE, "The function must contain the variable x.");
+            return ERR_INVALID_FUNCTION;
+        }
+    }
+    stats_phase(PHASE_VALIDATE, start);
+
+
+
+    // parse limits from input
+    double x_min = -10, x_max = 10, y_min = -10, y_max = 10;
+    if(limits) {
+        const char *message = NULL;
+        if (sscanf(limits, "%lf:%lf:%lf:%lf", &x_min, &x_max, &y_min, &y_max) != 4) {
+            message = "Invalid format for limits.";
+        }
+
+        // the limits and their ranges must be finite numbers
+        else if(!isfinite(x_min) || !isfinite(x_max) || !isfinite(y_min) || !isfinite(y_max) ||
+                !isfinite(x_max - x_min) || !isfinite(y_max - y_min)) {
+            message = "The limits must be finite numbers.";
+        }
+
+        // ensure min is less than max
+        else if(x_min >= x_max) {
+            message = "x_min must be less than x_max.";
+        }
+        else if(y_min >= y_max) {
+            message = "y_min must be less than y_max.";
+        }
+
+        if(message) {
+            if(stream) fclose(stream);
+            snprintf(error, ERROR_SIZE, "%s", message);
+            return ERR_INVALID_LIMITS;
+        }
+    }
+
+    // compile the functions or take them from the cache before the output
+    // is created, so a function which cannot be compiled leaves no file
+    program *programs[MAX_FUNCTIONS];
+    for(int i = 0; i < function_count; i++) {
+        programs[i] = o->cache ? expression_cache_get(o->cache, functions[i], o->evaluation)
+                               : compile_tokens(tokens[i], scratch);
+        if(!programs[i]) {
+            if(stream) fclose(stream);
+            snprintf(error, ERROR_SIZE, "Failed to compile the function %s", functions[i]);
+            release_programs(o, functions, programs, i);
+            return ERR_INVALID_FUNCTION;
+        }
+    }
+
+	// create a PostScript file
+    postscript *ps = NULL;
+    output_format format = output_format_of(outfile);
+    if(stream) {
+        ps = create_postscript_stream(stream, format, x_min, x_max, y_min, y_max);
+        if(!ps) fclose(stream);
+    } else {
+        FILE *file = fopen(outfile, format == OUTPUT_POSTSCRIPT ? "w" : "wb");
+        ps = file ? create_postscript_stream(file, format, x_min, x_max, y_min, y_max) : NULL;
+        if(file && !ps) {
+            fclose(file);
+            remove(outfile);
+        }
+    }
+    if(!ps) {
+        snprintf(error, ERROR_SIZE, "Failed to create PostScript file.");
+        release_programs(o, functions, programs, function_count);
+        return ERR_FILE_ERROR;
+    }
+    ps->scratch = scratch;
+
+    // the functions share the axes and the sampling of X, the graph takes
+    // the programs
+    for(int i = 0; i < function_count; i++) {
+        if(!add_program(ps, programs[i], colors[i])) {
+            snprintf(error, ERROR_SIZE, "Out of memory.");
+            close_postscript(ps);
+            release_programs(o, functions, programs, function_count);
+            if(!stream) remove(outfile);
+            return ERR_OUT_OF_MEMORY;
+        }
+        programs[i] = NULL;
+    }
+    ps->tolerance = o->tolerance;
+    ps->threads = o->threads;
+    ps->export_target = o->export_target;
+    ps->export_precision = o->export_precision;
+    ps->derivative_steps = o->derivative_steps;
+    ps->draw_slopes = o->draw_slopes;
+
+    // the samples of the functions are kept between renders, a function
+    // whose cache cannot be opened is sampled without it
+    for(int i = 0; o->tiles && i < function_count; i++) {
+        ps->plots[i].tiles = tile_cache_open(o->tiles, functions[i]);
+    }
+
+    // select the evaluation of the function, the interpreter is the fallback,
+    // cached functions come with the native code of their entry
+    int available = 1;
+    if(o->cache) {
+        for(size_t i = 0; i < ps->plot_count; i++) {
+            if(o->evaluation != BACKEND_INTERPRETER && !ps->plots[i].func->native) available = 0;
+        }
+    } else {
+        available = select_backend(ps, o->evaluation);
+    }
+    if(!available && o->verbose) {
+        printf("Warning: The selected backend is not available, using the interpreter.\n");
+    }
+
+    // print the optimized programs
+    for(size_t i = 0; o->dump && i < ps->plot_count; i++) program_dump(ps->plots[i].func, stdout);
+
+    // render axes, grid, and graph, the graph measures its own phases
+    start = stats_now();
+  	draw_square_axis(ps);
+    draw_ticks_and_labels(ps);
+    stats_phase(PHASE_EMIT, start);
+    graph_result drawn = draw_graph(ps);
+
+    // close the PostScript file
+    start = stats_now();
+    close_postscript(ps);
+    release_programs(o, functions, programs, function_count);
+    stats_phase(PHASE_EMIT, start);
+
+    if(drawn == GRAPH_NO_MEMORY) {
+        snprintf(error, ERROR_SIZE, "Out of memory while sampling the functions.");
+        return ERR_OUT_OF_MEMORY;
+    }
+    if(drawn == GRAPH_NOT_EXPORTED) {
+        snprintf(error, ERROR_SIZE, "Failed to export the samples to %s", o->export_target);
+        return ERR_FILE_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/* ____________________________________________________________________________
+
+    int render_graph(char *list, const char *outfile, FILE *stream,
+                     const char *limits, const render_options *o, char *error)
+
+    Renders the functions of the list into a PostScript file, the whole
+    path from the text of the functions to the closed file. The scratch
+    memory of the render comes from the arena of the options, which is
+    reset first, or from an arena of this render when the options have
+    none.
+
+    Parameters:
+        list - The functions separated by ';', it is modified in place
+        outfile - The name of the output file, its extension chooses the
+                  format
+        stream - An open stream receiving the graph instead of the file or
+                 NULL, it is closed by the render
+        limits - The limits in the format x_min:x_max:y_min:y_max or NULL
+        o - The options of the rendering
+        error - A buffer of ERROR_SIZE receiving the message of a failure
+
+    Returns:
+        SUCCESS (0) if the graph is generated successfully
+        Error codes for invalid arguments, functions, limits, files or memory
+   ____________________________________________________________________________
+*/
+int render_graph(char *list, const char *outfile, FILE *stream, const char *limits, const render_options *o, char *error) {
+
+    arena *scratch = o->scratch ? o->scratch : arena_create(0);
+    if(!scratch) {
+        if(stream) fclose(stream);
+        snprintf(error, ERROR_SIZE, "Out of memory.");
+        return ERR_OUT_OF_MEMORY;
+    }
+    arena_reset(scratch);
+
+    int result = render_functions(list, outfile, stream, limits, o, scratch, error);
+    stats_peak(COUNTER_ARENA_PEAK, arena_peak(scratch));
+
+    if(scratch != o->scratch) arena_free(&scratch);
+
+    return result;
+}
+
+/* ____________________________________________________________________________
+
+    int parse_job(char *line, job *j)
+
+    Splits a line of the job file into its functions, output file and
+    optional limits, the functions may contain spaces so the line is split
+    from its end
+
+    Parameters:
+        line - The line without its newline, it is modified in place
+        j - A pointer to the job receiving the parts
+
+    Returns:
+        1 if the line describes a graph
+        0 if the line is empty or a comment starting with '#'
+   ____________________________________________________________________________
+*/
+int parse_job(char *line, job *j) {
+
+    // trim the line
+    while(isspace((unsigned char)*line)) line++;
+    size_t length = strlen(line);
+    while(length > 0 && isspace((unsigned char)line[length - 1])) line[--length] = '\0';
+    if(length == 0 || line[0] == '#') return 0;
+
+    j->functions = line;
+    j->outfile = NULL;
+    j->limits = NULL;
+    j->status = SUCCESS;
+    j->error[0] = '\0';
+
+    // take the last word twice, limits start by a number and contain ':'
+    for(int word = 0; word < 2 && !j->outfile; word++) {
+        char *last = line + length;
+        while(last > line && !isspace((unsigned char)last[-1])) last--;
+        if(last == line) break;
+
+        char *end = last;
+        while(end > line && isspace((unsigned char)end[-1])) end--;
+        *end = '\0';
+        length = (size_t)(end - line);
+
+        if(word == 0 && strchr(last, ':') && strchr("0123456789+-.", last[0])) {
+            j->limits = last;
+        } else {
+            j->outfile = last;
+        }
+    }
+
+    if(!j->outfile) {
+        j->status = ERR_INVALID_ARGUMENTS;
+        snprintf(j->error, ERROR_SIZE, "Missing arguments, a job is <func> <out-file> [<limits>]");
+    }
+
+    return 1;
+}
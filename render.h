@@ -0,0 +1,66 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdio.h>
+#include "postscript.h"
+#include "exprcache.h"
+
+// constants for return
+#define SUCCESS 0
+#define ERR_INVALID_ARGUMENTS 1
+#define ERR_INVALID_FUNCTION 2
+#define ERR_FILE_ERROR 3
+#define ERR_INVALID_LIMITS 4
+#define ERR_OUT_OF_MEMORY 5
+
+// the most functions drawn into one graph
+#define MAX_FUNCTIONS 64
+
+// size of the error message of a render
+#define ERROR_SIZE 256
+
+/* ____________________________________________________________________________
+
+    Rendering of a Graph
+   ____________________________________________________________________________
+*/
+
+// options of the rendering shared by all graphs of the process
+typedef struct {
+    double tolerance;
+    int threads;        // number of threads sampling one graph
+    int dump;
+    backend evaluation;
+    int verbose;        // prints the progress of the render, off for job files
+    expression_cache *cache;    // compiled functions kept between renders or NULL
+    const char *tiles;          // directory of the tile caches or NULL
+    const char *export_target;  // file or "shm:<name>" receiving the samples or NULL
+    export_type export_precision;
+    int derivative_steps;       // samples by steps following the derivative
+    int draw_slopes;            // draws the derivatives below the functions
+    arena *scratch;             // memory of a render, reset by every render, or NULL
+} render_options;
+
+// a graph requested by a line of a job file or of the daemon
+typedef struct {
+    char *functions;
+    char *outfile;
+    char *limits;
+    int line;
+    int status;         // SUCCESS or an error code of the render
+    char error[ERROR_SIZE];
+} job;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+int split_functions(char *list, char **functions, color *colors);
+
+int render_graph(char *list, const char *outfile, FILE *stream, const char *limits, const render_options *o, char *error);
+
+int parse_job(char *line, job *j);
+
+#endif //RENDER_H
@@ -0,0 +1,1153 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#define SAMPLER_THREADS 1
+#endif
+#include "stack.h"
+#include "postfixmath.h"
+#include "sampler.h"
+#include "stats.h"
+#include "tilecache.h"
+#include "interval.h"
+
+// constants, all sizes are in device units
+#define SAMPLER_COARSE_STEP 2.0
+#define SAMPLER_TOLERANCE 0.1
+#define SAMPLER_MIN_WIDTH 0.01
+#define SAMPLER_MAX_DEPTH 32
+#define CURVE_INITIAL_CAPACITY 1024
+#define CURVE_SPLIT_CAPACITY 64
+#define SAMPLER_MAX_THREADS 256
+#define SAMPLER_PRUNE_SPAN 8
+#define SAMPLER_MAX_STEP 8.0
+#define SAMPLER_SAFETY 0.9
+#define SAMPLER_MAX_INTERVALS 1048576
+
+// the largest lattice index of the grid, the refinement multiplies it by
+// 2^SAMPLER_MAX_DEPTH and it has to stay exact in a double and a long long
+#define LATTICE_MAX_INDEX (1LL << 20)
+
+// the grid points first up to last lie on the lattice of a level of the
+// tile cache, the point first has the lattice index index
+typedef struct {
+    tile_cache *tiles;          // NULL when the samples are not cached
+    int level;
+    long long index;
+    size_t first;
+    size_t last;
+} lattice;
+
+// the samples first up to last of a run which the simplification splits
+typedef struct {
+    size_t first;
+    size_t last;
+} span;
+
+STACK_DEFINE(stack_span, span)
+
+/* ____________________________________________________________________________
+
+    curve *curve_create(size_t capacity)
+
+    Creates an empty curve
+
+    Parameters:
+        capacity - The number of samples to preallocate
+
+    Returns:
+        A pointer to the created curve or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+curve *curve_create(size_t capacity) {
+
+    if(!capacity) capacity = CURVE_INITIAL_CAPACITY;
+
+    // allocate memory for the curve structure
+    curve *c = (curve *)malloc(sizeof(curve));
+    if(!c) return NULL;
+
+    c->count = 0;
+    c->capacity = capacity;
+    c->x = (double *)malloc(sizeof(double) * capacity);
+    c->y = (double *)malloc(sizeof(double) * capacity);
+    if(!c->x || !c->y) {
+        curve_free(&c);
+        return NULL;
+    }
+
+    return c;
+}
+
+/* ____________________________________________________________________________
+
+    int curve_append(curve *c, double x, double y)
+
+    Adds a sample to the end of the curve, the storage grows as needed
+
+    Parameters:
+        c - A pointer to the curve
+        x - The X value of the sample
+        y - The Y value of the sample
+
+    Returns:
+        1 if the sample is successfully added
+        0 if memory allocation fails or invalid parameters are provided
+   ____________________________________________________________________________
+*/
+int curve_append(curve *c, double x, double y) {
+
+    // sanity check
+    if(!c) return 0;
+
+    // double the capacity when the curve is full
+    if(c->count == c->capacity) {
+        size_t capacity = c->capacity * 2;
+        double *xs = (double *)realloc(c->x, sizeof(double) * capacity);
+        if(!xs) return 0;
+        c->x = xs;
+        double *ys = (double *)realloc(c->y, sizeof(double) * capacity);
+        if(!ys) return 0;
+        c->y = ys;
+        c->capacity = capacity;
+    }
+
+    c->x[c->count] = x;
+    c->y[c->count] = y;
+    c->count++;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    void curve_free(curve **c)
+
+    Frees the memory allocated for the curve
+
+    Parameters:
+        c - A double pointer to the curve to be freed
+
+    Returns:
+        Nothing. The curve pointer is set to NULL after freeing memory
+   ____________________________________________________________________________
+*/
+void curve_free(curve **c) {
+
+    // sanity check
+    if(!c || !*c) return;
+
+    free((*c)->x);
+    free((*c)->y);
+    free(*c);
+    *c = NULL;
+}
+
+/* ____________________________________________________________________________
+
+    int sample_visible(const viewport *v, double y)
+
+    Checks if a value of the function lies inside the viewport
+
+    Parameters:
+        v - A pointer to the viewport
+        y - The value of the function
+
+    Returns:
+        1 if the value is drawn, 0 if it is NaN or out of range
+   ____________________________________________________________________________
+*/
+int sample_visible(const viewport *v, double y) {
+
+    return !isnan(y) && y >= v->y_min && y <= v->y_max;
+}
+
+/* ____________________________________________________________________________
+
+    static int refine(program *p, const viewport *v, curve *c, tile_cache *tiles,
+                      int level, long long k, double xa, double ya,
+                      double xb, double yb, int depth)
+
+    Recursively subdivides the interval between two samples and appends the
+    new interior samples in the order of x. An interval is split when
+
+    - its midpoint deviates from the chord by more than the tolerance
+    - some of the endpoints and the midpoint are visible and some are not,
+      to find the place where the curve leaves the viewport or its domain
+    - the curve crosses the whole viewport between the endpoints
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        c - A pointer to the curve receiving the samples
+        tiles - The tile cache of the samples, NULL when the interval is not
+                an interval of a lattice
+        level - The level of the lattice of the interval
+        k - The lattice index of the left sample
+        xa, ya - The left sample
+        xb, yb - The right sample
+        depth - The current depth of the recursion
+
+    Returns:
+        1 on success, 0 if memory allocation fails
+   ____________________________________________________________________________
+*/
+static int refine(program *p, const viewport *v, curve *c, tile_cache *tiles, int level, long long k,
+                  double xa, double ya, double xb, double yb, int depth) {
+
+    // the interval is already below the resolution
+    if(depth >= SAMPLER_MAX_DEPTH || (xb - xa) * v->scale_x < SAMPLER_MIN_WIDTH) return 1;
+
+    // the midpoint of the lattice interval k is the point 2k + 1 of the finer level
+    double xm = 0.5 * (xa + xb);
+    double ym;
+    if(!tiles || !tile_cache_lookup(tiles, level - 1, 2 * k + 1, &ym)) {
+        ym = evaluate_postfix_expression(p, xm);
+        if(tiles) tile_cache_store(tiles, level - 1, 2 * k + 1, ym);
+    }
+
+    int va = sample_visible(v, ya);
+    int vb = sample_visible(v, yb);
+    int vm = sample_visible(v, ym);
+
+    int split;
+    if(va && vb && vm) {
+        // distance of the midpoint from the chord in the device space
+        split = fabs(ym - 0.5 * (ya + yb)) * v->scale_y > SAMPLER_TOLERANCE;
+    } else if(va || vb || vm) {
+        // the curve enters or leaves the viewport inside the interval
+        split = 1;
+    } else {
+        // both endpoints are hidden, the curve may pass through the viewport
+        split = !isnan(ya) && !isnan(yb) &&
+                ((ya < v->y_min && yb > v->y_max) || (ya > v->y_max && yb < v->y_min));
+    }
+
+    if(!split) return 1;
+
+    return refine(p, v, c, tiles, level - 1, 2 * k, xa, ya, xm, ym, depth + 1) &&
+           curve_append(c, xm, ym) &&
+           refine(p, v, c, tiles, level - 1, 2 * k + 1, xm, ym, xb, yb, depth + 1);
+}
+
+/* ____________________________________________________________________________
+
+    static int point_pruned(const unsigned char *pruned, size_t intervals, size_t i)
+
+    Checks if a point of the coarse grid is skipped, the inner points of a
+    run of pruned intervals are neither evaluated nor appended
+
+    Parameters:
+        pruned - The flags of the pruned intervals of the grid
+        intervals - The number of intervals of the grid
+        i - Index of the point
+
+    Returns:
+        1 if the point is skipped, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int point_pruned(const unsigned char *pruned, size_t intervals, size_t i) {
+
+    return i > 0 && i < intervals && pruned[i - 1] && pruned[i];
+}
+
+/* ____________________________________________________________________________
+
+    static int sample_interval(program *p, const viewport *v, const curve *grid,
+                               const lattice *l, const unsigned char *pruned,
+                               size_t i, curve *c)
+
+    Refines one interval of the coarse grid and appends its samples, the
+    left endpoint of the interval is not appended
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        grid - A pointer to the coarse grid
+        l - A pointer to the lattice of the grid
+        pruned - The flags of the intervals where the curve is hidden
+        i - Index of the interval
+        c - A pointer to the curve receiving the samples
+
+    Returns:
+        1 on success, 0 if memory allocation fails
+   ____________________________________________________________________________
+*/
+static int sample_interval(program *p, const viewport *v, const curve *grid, const lattice *l, const unsigned char *pruned,
+                           size_t i, curve *c) {
+
+    // the curve cannot be visible inside a pruned interval, only the ends
+    // of the run of pruned intervals are kept to break the path
+    if(pruned[i]) {
+        return point_pruned(pruned, grid->count - 1, i + 1) || curve_append(c, grid->x[i + 1], grid->y[i + 1]);
+    }
+
+    // only the intervals between two lattice points are cached
+    int cached = l->tiles && i >= l->first && i < l->last;
+    tile_cache *tiles = cached ? l->tiles : NULL;
+    long long k = cached ? l->index + (long long)(i - l->first) : 0;
+
+    return refine(p, v, c, tiles, l->level, k, grid->x[i], grid->y[i], grid->x[i + 1], grid->y[i + 1], 0) &&
+           curve_append(c, grid->x[i + 1], grid->y[i + 1]);
+}
+
+/* ____________________________________________________________________________
+
+    static int sample_sequential(program *p, const viewport *v, const curve *grid,
+                                 const lattice *l, const unsigned char *pruned,
+                                 curve *c)
+
+    Refines the intervals of the coarse grid one after another
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        grid - A pointer to the coarse grid
+        l - A pointer to the lattice of the grid
+        pruned - The flags of the intervals where the curve is hidden
+        c - A pointer to the curve receiving the samples
+
+    Returns:
+        1 on success, 0 if memory allocation fails
+   ____________________________________________________________________________
+*/
+static int sample_sequential(program *p, const viewport *v, const curve *grid, const lattice *l, const unsigned char *pruned,
+                             curve *c) {
+
+    int ok = 1;
+    for(size_t i = 0; ok && i + 1 < grid->count; i++) {
+        ok = sample_interval(p, v, grid, l, pruned, i, c);
+    }
+
+    return ok;
+}
+
+#ifdef SAMPLER_THREADS
+
+// intervals of the grid owned by one worker, the owner takes them from the
+// front, the other workers steal them from the back
+typedef struct {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} task_range;
+
+typedef struct {
+    program *p;                 // private copy of the program
+    const viewport *v;
+    const curve *grid;
+    const lattice *l;
+    const unsigned char *pruned;
+    curve **results;            // samples of every interval
+    task_range *ranges;
+    int workers;
+    int index;
+    int failed;
+    stats_mark start;           // span of the worker for the trace
+    stats_mark end;
+} sampler_worker;
+
+/* ____________________________________________________________________________
+
+    static int take_task(task_range *range, int steal, size_t *task)
+
+    Takes an interval from a task range
+
+    Parameters:
+        range - A pointer to the task range
+        steal - 1 to take the last interval, 0 to take the first one
+        task - A pointer where the index of the interval will be stored
+
+    Returns:
+        1 if an interval was taken, 0 if the range is empty
+   ____________________________________________________________________________
+*/
+static int take_task(task_range *range, int steal, size_t *task) {
+
+    int taken = 0;
+
+    pthread_mutex_lock(&range->lock);
+    if(range->next < range->end) {
+        *task = steal ? --range->end : range->next++;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+
+    return taken;
+}
+
+/* ____________________________________________________________________________
+
+    static void *sampler_thread(void *argument)
+
+    Refines the intervals of its own range, then steals intervals from the
+    other workers until all ranges are empty
+
+    Parameters:
+        argument - A pointer to the sampler_worker
+
+    Returns:
+        NULL
+   ____________________________________________________________________________
+*/
+static void *sampler_thread(void *argument) {
+
+    sampler_worker *w = (sampler_worker *)argument;
+    size_t task;
+
+    w->start = stats_now();
+
+    for(int victim = 0; victim < w->workers; victim++) {
+        int owner = (w->index + victim) % w->workers;
+        while(take_task(&w->ranges[owner], owner != w->index, &task)) {
+            w->results[task] = curve_create(16);
+            if(!w->results[task] || !sample_interval(w->p, w->v, w->grid, w->l, w->pruned, task, w->results[task])) {
+                w->failed = 1;
+            }
+        }
+    }
+
+    w->end = stats_now();
+    return NULL;
+}
+
+/* ____________________________________________________________________________
+
+    static int sample_parallel(program *p, const viewport *v, const curve *grid,
+                               const lattice *l, const unsigned char *pruned,
+                               curve *c, int threads)
+
+    Refines the intervals of the coarse grid in several threads. Every
+    interval is sampled into its own curve and the curves are merged in the
+    order of x, so the result is the same as the one of a single thread.
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        grid - A pointer to the coarse grid
+        l - A pointer to the lattice of the grid, its cache is shared
+        pruned - The flags of the intervals where the curve is hidden
+        c - A pointer to the curve receiving the samples
+        threads - The number of threads
+
+    Returns:
+        1 on success, 0 if the threads or memory could not be allocated
+   ____________________________________________________________________________
+*/
+static int sample_parallel(program *p, const viewport *v, const curve *grid, const lattice *l, const unsigned char *pruned,
+                           curve *c, int threads) {
+
+    size_t intervals = grid->count - 1;
+    curve **results = (curve **)calloc(intervals, sizeof(curve *));
+    task_range *ranges = (task_range *)malloc(sizeof(task_range) * threads);
+    sampler_worker *workers = (sampler_worker *)calloc(threads, sizeof(sampler_worker));
+    pthread_t *ids = (pthread_t *)malloc(sizeof(pthread_t) * threads);
+    int ok = results && ranges && workers && ids;
+
+    // split the intervals evenly, every worker evaluates its own program
+    int created = 0;
+    for(int i = 0; ok && i < threads; i++) {
+        pthread_mutex_init(&ranges[i].lock, NULL);
+        ranges[i].next = intervals * i / threads;
+        ranges[i].end = intervals * (i + 1) / threads;
+        workers[i].p = program_copy(p);
+        workers[i].v = v;
+        workers[i].grid = grid;
+        workers[i].l = l;
+        workers[i].pruned = pruned;
+        workers[i].results = results;
+        workers[i].ranges = ranges;
+        workers[i].workers = threads;
+        workers[i].index = i;
+        ok = workers[i].p != NULL;
+        created = i + 1;
+    }
+
+    if(ok) {
+        // the calling thread is the first worker, ranges of threads which
+        // fail to start are stolen by the others
+        int started[threads];
+        for(int i = 1; i < threads; i++) {
+            started[i] = pthread_create(&ids[i], NULL, sampler_thread, &workers[i]) == 0;
+        }
+        sampler_thread(&workers[0]);
+        for(int i = 1; i < threads; i++) {
+            if(started[i]) pthread_join(ids[i], NULL);
+        }
+
+        // collect the evaluations and spans of the workers
+        for(int i = 0; i < threads; i++) {
+            p->evaluations += workers[i].p->evaluations;
+            if(i == 0 || started[i]) stats_span("refine", i, workers[i].start, workers[i].end);
+        }
+
+        // merge the samples in the order of the intervals
+        for(int i = 0; i < threads; i++) ok = ok && !workers[i].failed;
+        for(size_t t = 0; ok && t < intervals; t++) {
+            for(size_t j = 0; ok && j < results[t]->count; j++) {
+                ok = curve_append(c, results[t]->x[j], results[t]->y[j]);
+            }
+        }
+    }
+
+    // free memory
+    for(int i = 0; i < created; i++) {
+        pthread_mutex_destroy(&ranges[i].lock);
+        program_free(&workers[i].p);
+    }
+    for(size_t t = 0; results && t < intervals; t++) curve_free(&results[t]);
+    free(results);
+    free(ranges);
+    free(workers);
+    free(ids);
+
+    return ok;
+}
+
+#endif // SAMPLER_THREADS
+
+/* ____________________________________________________________________________
+
+    int sampler_default_threads(void)
+
+    Returns the number of threads used for sampling by default
+
+    Parameters:
+        None
+
+    Returns:
+        The number of online processors, 1 without thread support
+   ____________________________________________________________________________
+*/
+int sampler_default_threads(void) {
+
+#ifdef SAMPLER_THREADS
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    if(processors > 1) return processors > SAMPLER_MAX_THREADS ? SAMPLER_MAX_THREADS : (int)processors;
+#endif
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static int viewport_valid(const viewport *v)
+
+    Checks if the range of a viewport can be sampled, the limits, their
+    distance and the scale must be finite to give the grid a size
+
+    Parameters:
+        v - A pointer to the viewport
+
+    Returns:
+        1 if the range is finite and not empty, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int viewport_valid(const viewport *v) {
+
+    return isfinite(v->x_min) && isfinite(v->x_max) && v->x_min < v->x_max &&
+           isfinite(v->x_max - v->x_min) && isfinite(v->scale_x) && v->scale_x > 0.0;
+}
+
+/* ____________________________________________________________________________
+
+    static size_t lattice_grid(const viewport *v, double step, lattice *l,
+                               double **xs, arena *scratch)
+
+    Places the coarse grid on the dyadic lattice of the tile cache, the
+    level is the finest one whose step is not larger than the step of the
+    grid, the ends of the viewport are added when they are not lattice points
+
+    Parameters:
+        v - A pointer to the viewport
+        step - The step of the uniform grid
+        l - A pointer to the lattice receiving the level and the range
+        xs - A pointer receiving the allocated X values of the grid
+        scratch - The arena of the X values or NULL for the heap
+
+    Returns:
+        The number of grid points or 0 if the viewport is too far from the
+        origin for its lattice or memory allocation fails
+   ____________________________________________________________________________
+*/
+static size_t lattice_grid(const viewport *v, double step, lattice *l, double **xs, arena *scratch) {
+
+    int exponent;
+    frexp(step, &exponent);
+    l->level = exponent - 1;
+
+    double lattice_step = ldexp(1.0, l->level);
+    double first = ceil(v->x_min / lattice_step);
+    double last = floor(v->x_max / lattice_step);
+    if(fabs(first) > LATTICE_MAX_INDEX || fabs(last) > LATTICE_MAX_INDEX || last < first) return 0;
+
+    l->index = (long long)first;
+    l->first = ldexp(first, l->level) > v->x_min ? 1 : 0;
+    l->last = l->first + (size_t)(last - first);
+    size_t n = l->last + 1 + (ldexp(last, l->level) < v->x_max ? 1 : 0);
+
+    *xs = (double *)arena_alloc(scratch, sizeof(double) * n);
+    if(!*xs) return 0;
+
+    (*xs)[0] = v->x_min;
+    for(size_t i = l->first; i <= l->last; i++) {
+        (*xs)[i] = ldexp((double)(l->index + (long long)(i - l->first)), l->level);
+    }
+    (*xs)[n - 1] = v->x_max;
+
+    return n;
+}
+
+/* ____________________________________________________________________________
+
+    static void prune_grid(const program *p, const viewport *v, const double *xs,
+                           size_t first, size_t last, interval *stack,
+                           unsigned char *pruned)
+
+    Marks the intervals of the coarse grid where the curve cannot be
+    visible. The program is bounded by interval arithmetic over the range
+    of grid points, a range whose values all lie outside the viewport or
+    are undefined is pruned, a range reaching into the viewport is split
+    in halves until it gets shorter than SAMPLER_PRUNE_SPAN intervals. A
+    range lying inside the viewport is not split, nothing in it is hidden.
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        xs - The X values of the grid
+        first - The first point of the range
+        last - The last point of the range
+        stack - The working memory of program_enclose
+        pruned - The flags of the intervals, set to 1 for pruned ones
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void prune_grid(const program *p, const viewport *v, const double *xs, size_t first, size_t last,
+                       interval *stack, unsigned char *pruned) {
+
+    interval y;
+    if(last - first < SAMPLER_PRUNE_SPAN || !program_enclose(p, xs[first], xs[last], stack, &y)) return;
+
+    if(interval_empty(y) || y.hi < v->y_min || y.lo > v->y_max) {
+        memset(pruned + first, 1, last - first);
+        return;
+    }
+    if(y.lo >= v->y_min && y.hi <= v->y_max) return;
+
+    size_t middle = first + (last - first) / 2;
+    prune_grid(p, v, xs, first, middle, stack, pruned);
+    prune_grid(p, v, xs, middle, last, stack, pruned);
+}
+
+/* ____________________________________________________________________________
+
+    static void evaluate_grid(program *p, const lattice *l, const unsigned char *pruned,
+                              size_t intervals, const double *xs, double *ys,
+                              size_t start, size_t count)
+
+    Evaluates a block of the coarse grid, the lattice points found in the
+    tile cache are taken from it and only the missing ones are evaluated
+    and stored, skipped points of pruned intervals get NaN
+
+    Parameters:
+        p - A pointer to the compiled program
+        l - A pointer to the lattice of the grid
+        pruned - The flags of the pruned intervals
+        intervals - The number of intervals of the grid
+        xs - The X values of the grid
+        ys - The values of the function on the grid
+        start - The first point of the block
+        count - The number of points, at most PROGRAM_BLOCK_SIZE
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void evaluate_grid(program *p, const lattice *l, const unsigned char *pruned, size_t intervals,
+                          const double *xs, double *ys, size_t start, size_t count) {
+
+    double missing_x[PROGRAM_BLOCK_SIZE], missing_y[PROGRAM_BLOCK_SIZE];
+    size_t missing_at[PROGRAM_BLOCK_SIZE];
+    size_t missing = 0;
+
+    for(size_t i = start; i < start + count; i++) {
+        if(point_pruned(pruned, intervals, i)) {
+            ys[i] = NAN;
+            continue;
+        }
+
+        int on_lattice = l->tiles && i >= l->first && i <= l->last;
+        long long k = l->index + (long long)(i - l->first);
+        if(on_lattice && tile_cache_lookup(l->tiles, l->level, k, &ys[i])) continue;
+
+        missing_x[missing] = xs[i];
+        missing_at[missing++] = i;
+    }
+
+    // a block without skipped points is evaluated in place
+    if(missing == count) {
+        evaluate_postfix_batch(p, xs + start, ys + start, count);
+    } else if(missing > 0) {
+        evaluate_postfix_batch(p, missing_x, missing_y, missing);
+        for(size_t j = 0; j < missing; j++) ys[missing_at[j]] = missing_y[j];
+    }
+
+    for(size_t j = 0; l->tiles && j < missing; j++) {
+        size_t i = missing_at[j];
+        if(i >= l->first && i <= l->last) {
+            tile_cache_store(l->tiles, l->level, l->index + (long long)(i - l->first), ys[i]);
+        }
+    }
+}
+
+/* ____________________________________________________________________________
+
+    int sample_functions(program **p, tile_cache **tiles, size_t count,
+                         const viewport *v, int threads, curve **curves,
+                         arena *scratch)
+
+    Samples several functions over the viewport. The functions are
+    evaluated on a coarse grid with a fixed step in the device space, then
+    every interval is refined only where the curve needs it, so the number
+    of samples follows the complexity of the curve instead of the numeric
+    range. The grid is shared by all functions and swept once, every
+    block of X values is evaluated by all functions while it is in the
+    cache. The intervals are refined in parallel when more threads are
+    requested, the samples are the same for any number of threads.
+
+    With tile caches the grid lies on a dyadic lattice instead, so the
+    midpoints of the refinement are lattice points of the finer levels as
+    well and every sample another render has evaluated at the same point
+    is taken from the cache. A panned or zoomed render evaluates only the
+    newly exposed part of the curve.
+
+    Before the grid is evaluated, the ranges of the grid where a function
+    is hidden or undefined are found by interval arithmetic, they are
+    neither evaluated nor refined.
+
+    Parameters:
+        p - An array of pointers to the compiled programs
+        tiles - An array of the tile caches of the programs or NULL, a
+                program without a cache has a NULL entry
+        count - The number of programs
+        v - A pointer to the viewport
+        threads - The number of threads refining the intervals
+        curves - An array receiving the sampled curve of every program
+        scratch - The arena of the grid or NULL for the heap, the curves
+                  are always allocated from the heap
+
+    Returns:
+        1 on success, 0 if memory allocation fails, the curves are NULL then
+   ____________________________________________________________________________
+*/
+int sample_functions(program **p, tile_cache **tiles, size_t count, const viewport *v, int threads, curve **curves, arena *scratch) {
+
+    // sanity check
+    if(!p || !v || !curves || !viewport_valid(v)) return 0;
+    for(size_t k = 0; k < count; k++) curves[k] = NULL;
+
+    // coarse grid derived from the scale of the X axis
+    double span = ceil((v->x_max - v->x_min) * v->scale_x / SAMPLER_COARSE_STEP);
+    size_t intervals = span < 1.0 ? 1 : span > SAMPLER_MAX_INTERVALS ? SAMPLER_MAX_INTERVALS : (size_t)span;
+    double step = (v->x_max - v->x_min) / intervals;
+    size_t n = 0;
+
+    // with a tile cache the grid lies on a lattice
+    double *xs = NULL;
+    lattice grid_lattice = {NULL, 0, 0, 0, 0};
+    int cached = 0;
+    for(size_t k = 0; tiles && k < count; k++) cached = cached || tiles[k] != NULL;
+    if(cached) n = lattice_grid(v, step, &grid_lattice, &xs, scratch);
+
+    // the uniform grid, no point lies on a lattice
+    if(!xs) {
+        cached = 0;
+        n = intervals + 1;
+        xs = (double *)arena_alloc(scratch, sizeof(double) * n);
+        for(size_t i = 0; xs && i < n; i++) {
+            xs[i] = i == intervals ? v->x_max : v->x_min + (double)i * step;
+        }
+    }
+    intervals = n - 1;
+
+    // the interval arithmetic shares one stack deep enough for every program
+    size_t depth = 1;
+    for(size_t k = 0; k < count; k++) {
+        if(p[k]->depth + p[k]->slots > depth) depth = p[k]->depth + p[k]->slots;
+    }
+
+    double *ys = (double *)arena_alloc(scratch, sizeof(double) * n * count);
+    lattice *lattices = (lattice *)arena_alloc(scratch, sizeof(lattice) * (count ? count : 1));
+    unsigned char *pruned = (unsigned char *)arena_calloc(scratch, intervals * count + 1, 1);
+    interval *stack = (interval *)arena_alloc(scratch, sizeof(interval) * depth);
+    if(!xs || !ys || !lattices || !pruned || !stack) {
+        arena_release(scratch, xs);
+        arena_release(scratch, ys);
+        arena_release(scratch, lattices);
+        arena_release(scratch, pruned);
+        arena_release(scratch, stack);
+        return 0;
+    }
+
+    // skip the ranges where a function cannot be visible
+    size_t skipped = 0;
+    for(size_t k = 0; k < count; k++) {
+        prune_grid(p[k], v, xs, 0, intervals, stack, pruned + k * intervals);
+        for(size_t i = 1; i < intervals; i++) skipped += point_pruned(pruned + k * intervals, intervals, i);
+    }
+    stats_count(COUNTER_PRUNED_SAMPLES, skipped);
+
+    // every function caches its samples on the lattice of the grid
+    for(size_t k = 0; k < count; k++) {
+        lattices[k] = grid_lattice;
+        lattices[k].tiles = cached ? tiles[k] : NULL;
+    }
+
+    // evaluate the grid in one sweep over the shared X values
+    for(size_t start = 0; start < n; start += PROGRAM_BLOCK_SIZE) {
+        size_t block = n - start < PROGRAM_BLOCK_SIZE ? n - start : PROGRAM_BLOCK_SIZE;
+        for(size_t k = 0; k < count; k++) {
+            evaluate_grid(p[k], &lattices[k], pruned + k * intervals, intervals, xs, ys + k * n, start, block);
+        }
+    }
+
+    if(threads > SAMPLER_MAX_THREADS) threads = SAMPLER_MAX_THREADS;
+    if(threads > 1 && (size_t)threads > intervals) threads = (int)intervals;
+
+    // refine every interval of the grid, separately for every function
+    int ok = 1;
+    for(size_t k = 0; ok && k < count; k++) {
+        curve grid = {xs, ys + k * n, n, n};
+
+        curves[k] = curve_create(4 * n);
+        ok = curves[k] && curve_append(curves[k], grid.x[0], grid.y[0]);
+        if(ok) {
+#ifdef SAMPLER_THREADS
+            ok = threads > 1 ? sample_parallel(p[k], v, &grid, &lattices[k], pruned + k * intervals, curves[k], threads) :
+                               sample_sequential(p[k], v, &grid, &lattices[k], pruned + k * intervals, curves[k]);
+#else
+            ok = sample_sequential(p[k], v, &grid, &lattices[k], pruned + k * intervals, curves[k]);
+#endif
+        }
+    }
+
+    arena_release(scratch, xs);
+    arena_release(scratch, ys);
+    arena_release(scratch, lattices);
+    arena_release(scratch, pruned);
+    arena_release(scratch, stack);
+    if(!ok) {
+        for(size_t k = 0; k < count; k++) curve_free(&curves[k]);
+    }
+
+    return ok;
+}
+
+/* ____________________________________________________________________________
+
+    curve *sample_function(program *p, const viewport *v, int threads)
+
+    Samples a single function over the viewport, see sample_functions
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        threads - The number of threads refining the intervals
+
+    Returns:
+        A pointer to the sampled curve or NULL if memory allocation fails
+   ____________________________________________________________________________
+*/
+curve *sample_function(program *p, const viewport *v, int threads) {
+
+    curve *c = NULL;
+
+    // sanity check
+    if(!p) return NULL;
+
+    return sample_functions(&p, NULL, 1, v, threads, &c, NULL) ? c : NULL;
+}
+
+/* ____________________________________________________________________________
+
+    static int sample_steps(program *p, const viewport *v, curve *c, curve *slopes)
+
+    Walks over the viewport by steps whose size follows the derivative.
+    The curve between two samples is estimated by the cubic matching
+    their values and slopes, its largest distance from the chord is below
+    h * (|f'(a) - m| + |f'(b) - m|) / 4 for the slope m of the chord. A
+    step above the tolerance is halved and tried again, an accepted step
+    grows by the square root of the remaining error, up to
+    SAMPLER_MAX_STEP. Steps entering or leaving the viewport shrink to
+    the resolution like the intervals of refine.
+
+    Parameters:
+        p - A pointer to the compiled program
+        v - A pointer to the viewport
+        c - A pointer to the curve receiving the samples
+        slopes - A pointer to the curve receiving the derivatives at the
+                 same X values or NULL
+
+    Returns:
+        1 on success, 0 if memory allocation fails
+   ____________________________________________________________________________
+*/
+static int sample_steps(program *p, const viewport *v, curve *c, curve *slopes) {
+
+    double min_step = SAMPLER_MIN_WIDTH / v->scale_x;
+    double max_step = SAMPLER_MAX_STEP / v->scale_x;
+    double step = SAMPLER_COARSE_STEP / v->scale_x;
+
+    double xa = v->x_min, sa;
+    double ya = evaluate_postfix_dual(p, xa, &sa);
+    if(!curve_append(c, xa, ya) || (slopes && !curve_append(slopes, xa, sa))) return 0;
+
+    while(xa < v->x_max) {
+        // a step below the spacing of the doubles at xa still advances
+        int last = step >= v->x_max - xa;
+        double xb = last ? v->x_max : fmax(xa + step, nextafter(xa, INFINITY)), sb;
+        double yb = evaluate_postfix_dual(p, xb, &sb);
+
+        int va = sample_visible(v, ya);
+        int vb = sample_visible(v, yb);
+        double growth = 2.0;
+
+        if(va && vb) {
+            // distance of the curve from the chord in the device space
+            double m = (yb - ya) / (xb - xa);
+            double error = (xb - xa) * (fabs(sa - m) + fabs(sb - m)) / 4.0 * v->scale_y;
+            if(!(error <= SAMPLER_TOLERANCE) && step > min_step) {
+                step = fmax(0.5 * step, min_step);
+                continue;
+            }
+            if(error > 0.0) growth = fmin(growth, SAMPLER_SAFETY * sqrt(SAMPLER_TOLERANCE / error));
+        } else if(va || vb || (!isnan(ya) && !isnan(yb) &&
+                               ((ya < v->y_min && yb > v->y_max) || (ya > v->y_max && yb < v->y_min)))) {
+            // the curve enters or leaves the viewport, or crosses it
+            if(step > min_step) {
+                step = fmax(0.5 * step, min_step);
+                continue;
+            }
+        }
+
+        if(!curve_append(c, xb, yb) || (slopes && !curve_append(slopes, xb, sb))) return 0;
+        xa = xb;
+        ya = yb;
+        sa = sb;
+        step = fmin(fmax(step * growth, min_step), max_step);
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    int sample_derivative(program **p, size_t count, const viewport *v,
+                          curve **curves, curve **slopes)
+
+    Samples several functions over the viewport by steps controlled by
+    their derivatives, which come from the evaluation on dual numbers
+    instead of finite differences. Flat parts of a curve are crossed by
+    long steps and steep or bent parts by short ones. The functions are
+    sampled one after another by the interpreter, without tile caches.
+
+    Parameters:
+        p - An array of pointers to the compiled programs
+        count - The number of programs
+        v - A pointer to the viewport
+        curves - An array receiving the sampled curve of every program
+        slopes - An array receiving the derivative of every program at the
+                 samples of its curve, or NULL
+
+    Returns:
+        1 on success, 0 if memory allocation fails, the curves are NULL then
+   ____________________________________________________________________________
+*/
+int sample_derivative(program **p, size_t count, const viewport *v, curve **curves, curve **slopes) {
+
+    // sanity check
+    if(!p || !v || !curves || !viewport_valid(v)) return 0;
+    for(size_t k = 0; k < count; k++) {
+        curves[k] = NULL;
+        if(slopes) slopes[k] = NULL;
+    }
+
+    int ok = 1;
+    for(size_t k = 0; ok && k < count; k++) {
+        curves[k] = curve_create(0);
+        if(slopes) slopes[k] = curve_create(0);
+        ok = curves[k] && (!slopes || slopes[k]) && sample_steps(p[k], v, curves[k], slopes ? slopes[k] : NULL);
+    }
+
+    if(!ok) {
+        for(size_t k = 0; k < count; k++) {
+            curve_free(&curves[k]);
+            if(slopes) curve_free(&slopes[k]);
+        }
+    }
+
+    return ok;
+}
+
+/* ____________________________________________________________________________
+
+    curve *sample_slopes(program *p, const curve *c)
+
+    Evaluates the derivative of a function at the samples of its curve
+
+    Parameters:
+        p - A pointer to the compiled program
+        c - A pointer to the curve of the function
+
+    Returns:
+        A pointer to the curve of the derivative or NULL if memory
+        allocation fails
+   ____________________________________________________________________________
+*/
+curve *sample_slopes(program *p, const curve *c) {
+
+    // sanity check
+    if(!p || !c) return NULL;
+
+    curve *slopes = curve_create(c->count);
+    for(size_t i = 0; slopes && i < c->count; i++) {
+        double slope;
+        evaluate_postfix_dual(p, c->x[i], &slope);
+        curve_append(slopes, c->x[i], slope);
+    }
+
+    return slopes;
+}
+
+/* ____________________________________________________________________________
+
+    static double segment_distance(const viewport *v, const curve *c,
+                                   size_t a, size_t b, size_t i)
+
+    Computes the distance of a sample from the segment between two other
+    samples in the device space
+
+    Parameters:
+        v - A pointer to the viewport
+        c - A pointer to the curve
+        a, b - Indices of the endpoints of the segment
+        i - Index of the sample
+
+    Returns:
+        The distance in device units
+   ____________________________________________________________________________
+*/
+static double segment_distance(const viewport *v, const curve *c, size_t a, size_t b, size_t i) {
+
+    double ax = c->x[a] * v->scale_x, ay = c->y[a] * v->scale_y;
+    double dx = c->x[b] * v->scale_x - ax, dy = c->y[b] * v->scale_y - ay;
+    double px = c->x[i] * v->scale_x - ax, py = c->y[i] * v->scale_y - ay;
+
+    // projection of the sample clamped to the segment
+    double length = dx * dx + dy * dy;
+    double t = length > 0.0 ? (px * dx + py * dy) / length : 0.0;
+    if(t < 0.0) t = 0.0;
+    if(t > 1.0) t = 1.0;
+
+    return hypot(px - t * dx, py - t * dy);
+}
+
+/* ____________________________________________________________________________
+
+    int curve_simplify(curve *c, const viewport *v, double tolerance, arena *scratch)
+
+    Simplifies every visible run of the curve by the Douglas-Peucker
+    algorithm, a sample is dropped when the polyline without it stays within
+    the tolerance. Hidden samples are kept, so the curve breaks at the same
+    places.
+
+    Parameters:
+        c - A pointer to the curve, simplified in place
+        v - A pointer to the viewport
+        tolerance - The maximal deviation in device units
+        scratch - The arena of the working memory or NULL for the heap
+
+    Returns:
+        1 on success, 0 if memory allocation fails or invalid parameters
+        are provided
+   ____________________________________________________________________________
+*/
+int curve_simplify(curve *c, const viewport *v, double tolerance, arena *scratch) {
+
+    // sanity check
+    if(!c || !v || tolerance < 0.0) return 0;
+    if(c->count < 3) return 1;
+
+    // flags of the samples which stay in the curve
+    char *keep = (char *)arena_calloc(scratch, c->count, sizeof(char));
+    stack_span *segments = stack_span_create(CURVE_SPLIT_CAPACITY, scratch);
+    if(!keep || !segments) {
+        arena_release(scratch, keep);
+        stack_span_free(&segments);
+        return 0;
+    }
+
+    size_t i = 0;
+    int ok = 1;
+    while(ok && i < c->count) {
+
+        // hidden samples are kept as breaks of the curve
+        if(!sample_visible(v, c->y[i])) {
+            keep[i++] = 1;
+            continue;
+        }
+
+        // find the end of the visible run
+        size_t first = i;
+        while(i + 1 < c->count && sample_visible(v, c->y[i + 1])) i++;
+        size_t last = i++;
+
+        keep[first] = 1;
+        keep[last] = 1;
+        span segment = {first, last};
+        ok = stack_span_push(segments, segment);
+
+        // split the segments at the farthest sample until all are close
+        while(ok && stack_span_pop(segments, &segment)) {
+            double max_distance = 0.0;
+            size_t farthest = 0;
+            for(size_t j = segment.first + 1; j < segment.last; j++) {
+                double distance = segment_distance(v, c, segment.first, segment.last, j);
+                if(distance > max_distance) {
+                    max_distance = distance;
+                    farthest = j;
+                }
+            }
+
+            if(max_distance > tolerance) {
+                keep[farthest] = 1;
+                span left = {segment.first, farthest};
+                span right = {farthest, segment.last};
+                ok = stack_span_push(segments, left) && stack_span_push(segments, right);
+            }
+        }
+    }
+
+    // move the kept samples to the front, the curve stays whole when a
+    // split cannot be stored
+    size_t count = 0;
+    for(i = 0; ok && i < c->count; i++) {
+        if(keep[i]) {
+            c->x[count] = c->x[i];
+            c->y[count] = c->y[i];
+            count++;
+        }
+    }
+    if(ok) c->count = count;
+
+    arena_release(scratch, keep);
+    stack_span_free(&segments);
+
+    return ok;
+}
@@ -0,0 +1,59 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "postfixmath.h"
+#include "tilecache.h"
+
+/* ____________________________________________________________________________
+
+    Sampled Curve
+   ____________________________________________________________________________
+*/
+
+// visible part of the plane and its mapping to the device space
+typedef struct {
+    double x_min;
+    double x_max;
+    double y_min;
+    double y_max;
+    double scale_x;
+    double scale_y;
+} viewport;
+
+// samples of a function ordered by x, invalid samples break the curve
+typedef struct {
+    double *x;
+    double *y;
+    size_t count;
+    size_t capacity;
+} curve;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+curve *curve_create(size_t capacity);
+
+int curve_append(curve *c, double x, double y);
+
+void curve_free(curve **c);
+
+int sample_visible(const viewport *v, double y);
+
+int sampler_default_threads(void);
+
+int sample_functions(program **p, tile_cache **tiles, size_t count, const viewport *v, int threads, curve **curves, arena *scratch);
+
+curve *sample_function(program *p, const viewport *v, int threads);
+
+int sample_derivative(program **p, size_t count, const viewport *v, curve **curves, curve **slopes);
+
+curve *sample_slopes(program *p, const curve *c);
+
+int curve_simplify(curve *c, const viewport *v, double tolerance, arena *scratch);
+
+#endif //SAMPLER_H
@@ -1,12 +1,13 @@
 #ifndef SHUNTINGYARD_H
 #define SHUNTINGYARD_H
 
-#include "queue.h"
+#include "arena.h"
+#include "expression.h"
 /* ____________________________________________________________________________
 
     Function Prototypes
    ____________________________________________________________________________
 */
-void shunting_yard(const char *expression, queue *output);
+int shunting_yard(const queue_token *tokens, queue_token *output, arena *scratch);
 
 #endif //SHUNTINGYARD_H
@@ -1,28 +1,109 @@
 #ifndef __STACK__
 #define __STACK__
-/* ____________________________________________________________________________
 
-    Function Prototypes
-   ____________________________________________________________________________
-*/
-typedef unsigned int uint;
-typedef struct{
-    int sp;
-    uint size, item_size;
-    void *items;
-} stack;
+#include <stddef.h>
+#include "arena.h"
 
-stack *stack_create(uint size, uint item_size);
+typedef unsigned int uint;
 
-int stack_push(stack *s, void *item);
+/* ____________________________________________________________________________
 
-int stack_pop(stack *s, void *item);
+    Typed Stacks
 
-int stack_peek(stack *s, void *item);
+    STACK_DEFINE(name, type) defines the stack type name holding items of
+    type and its functions, every function starts with the name:
 
-void stack_free(stack **s);
+        name *name_create(size_t capacity, arena *scratch)
+        int name_push(name *s, type item)
+        int name_pop(name *s, type *item)
+        int name_peek(const name *s, type *item)
+        int name_get(const name *s, size_t index, type *item)
+        void name_free(name **s)
 
+    Items are copied by assignment. A full stack doubles its capacity, so
+    a push fails only when memory allocation fails. name_get reads the
+    items from the bottom without removing them. A stack of an arena
+    stays in the arena until it is reset, NULL allocates from the heap.
 
+        STACK_DEFINE(stack_double, double)
+   ____________________________________________________________________________
+*/
 
+#define STACK_DEFINE(name, type)                                                \
+                                                                                \
+typedef struct {                                                                \
+    type *items;                                                                \
+    size_t count;                                                               \
+    size_t capacity;                                                            \
+    arena *scratch;     /* the arena of the stack or NULL for the heap */       \
+} name;                                                                         \
+                                                                                \
+static inline name *name##_create(size_t capacity, arena *scratch) {            \
+                                                                                \
+    name *s = (name *)arena_alloc(scratch, sizeof(name));                       \
+    if(!s) return NULL;                                                         \
+                                                                                \
+    s->count = 0;                                                               \
+    s->capacity = capacity ? capacity : 1;                                      \
+    s->scratch = scratch;                                                       \
+    s->items = (type *)arena_alloc(scratch, sizeof(type) * s->capacity);        \
+    if(!s->items) {                                                             \
+        arena_release(scratch, s);                                              \
+        return NULL;                                                            \
+    }                                                                           \
+                                                                                \
+    return s;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_push(name *s, type item) {                             \
+                                                                                \
+    if(!s) return 0;                                                            \
+                                                                                \
+    if(s->count == s->capacity) {                                               \
+        if(s->capacity > (size_t)-1 / (2 * sizeof(type))) return 0;             \
+        type *items = (type *)arena_grow(s->scratch, s->items,                  \
+                                         sizeof(type) * s->capacity,            \
+                                         sizeof(type) * 2 * s->capacity);       \
+        if(!items) return 0;                                                    \
+        s->items = items;                                                       \
+        s->capacity *= 2;                                                       \
+    }                                                                           \
+                                                                                \
+    s->items[s->count++] = item;                                                \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_pop(name *s, type *item) {                             \
+                                                                                \
+    if(!s || !item || s->count == 0) return 0;                                  \
+                                                                                \
+    *item = s->items[--s->count];                                               \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_peek(const name *s, type *item) {                      \
+                                                                                \
+    if(!s || !item || s->count == 0) return 0;                                  \
+                                                                                \
+    *item = s->items[s->count - 1];                                             \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline int name##_get(const name *s, size_t index, type *item) {         \
+                                                                                \
+    if(!s || !item || index >= s->count) return 0;                              \
+                                                                                \
+    *item = s->items[index];                                                    \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+static inline void name##_free(name **s) {                                      \
+                                                                                \
+    if(!s || !*s) return;                                                       \
+                                                                                \
+    arena_release((*s)->scratch, (*s)->items);                                  \
+    arena_release((*s)->scratch, *s);                                           \
+    *s = NULL;                                                                  \
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,310 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "stats.h"
+
+// constants
+#define TRACE_INITIAL_CAPACITY 64
+
+// names of the phases in the order of phase
+static const char *phase_names[PHASE_COUNT] = {"preprocess", "validate", "parse", "compile",
+                                               "sample", "simplify", "emit"};
+
+// names of the counters in the order of counter
+static const char *counter_names[COUNTER_COUNT] = {"evaluations", "nan samples", "out of range",
+                                                   "pen ups", "bytes written", "nodes removed",
+                                                   "cached samples", "pruned samples", "arena peak bytes"};
+
+// a finished span of the trace
+typedef struct {
+    const char *name;
+    int thread;
+    double start;
+    double duration;
+} trace_event;
+
+// the renders of a job file record from several threads
+#ifndef _WIN32
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+#define STATS_LOCK() pthread_mutex_lock(&stats_lock)
+#define STATS_UNLOCK() pthread_mutex_unlock(&stats_lock)
+#else
+#define STATS_LOCK()
+#define STATS_UNLOCK()
+#endif
+
+// state of the statistics, started and finished by the main thread
+static struct {
+    stats_mark origin;
+    double wall[PHASE_COUNT];
+    double cpu[PHASE_COUNT];
+    unsigned long long counters[COUNTER_COUNT];
+    const char *trace_file;
+    trace_event *events;
+    size_t count;
+    size_t capacity;
+} stats;
+
+/* ____________________________________________________________________________
+
+    stats_mark stats_now(void)
+
+    Returns the current wall clock and CPU time of the process, the CPU
+    time includes all threads
+
+    Parameters:
+        None
+
+    Returns:
+        The current stats_mark
+   ____________________________________________________________________________
+*/
+stats_mark stats_now(void) {
+
+    stats_mark m;
+
+#ifdef _WIN32
+    m.cpu = (double)clock() / CLOCKS_PER_SEC;
+    m.wall = m.cpu;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    m.wall = (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    m.cpu = (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+#endif
+
+    return m;
+}
+
+/* ____________________________________________________________________________
+
+    void stats_start(const char *trace_file)
+
+    Resets the statistics and starts measuring
+
+    Parameters:
+        trace_file - The file of the Chrome trace, NULL to record no trace
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void stats_start(const char *trace_file) {
+
+    free(stats.events);
+    memset(&stats, 0, sizeof(stats));
+
+    stats.trace_file = trace_file;
+    stats.origin = stats_now();
+}
+
+/* ____________________________________________________________________________
+
+    void stats_span(const char *name, int thread, stats_mark start, stats_mark end)
+
+    Records a span of the trace
+
+    Parameters:
+        name - The name of the span, it has to outlive the statistics
+        thread - The index of the thread, 0 for the main thread
+        start - The beginning of the span
+        end - The end of the span
+
+    Returns:
+        Nothing. Spans which cannot be stored are dropped
+   ____________________________________________________________________________
+*/
+void stats_span(const char *name, int thread, stats_mark start, stats_mark end) {
+
+    // sanity check
+    if(!stats.trace_file || !name) return;
+
+    STATS_LOCK();
+    if(stats.count == stats.capacity) {
+        size_t capacity = stats.capacity ? 2 * stats.capacity : TRACE_INITIAL_CAPACITY;
+        trace_event *events = (trace_event *)realloc(stats.events, sizeof(trace_event) * capacity);
+        if(!events) {
+            STATS_UNLOCK();
+            return;
+        }
+        stats.events = events;
+        stats.capacity = capacity;
+    }
+
+    trace_event *e = &stats.events[stats.count++];
+    e->name = name;
+    e->thread = thread;
+    e->start = start.wall - stats.origin.wall;
+    e->duration = end.wall - start.wall;
+    STATS_UNLOCK();
+}
+
+/* ____________________________________________________________________________
+
+    void stats_phase(phase p, stats_mark start)
+
+    Adds the time from start until now to a phase and traces it as a span
+    of the main thread
+
+    Parameters:
+        p - The phase
+        start - The beginning of the phase
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void stats_phase(phase p, stats_mark start) {
+
+    // sanity check
+    if(p < 0 || p >= PHASE_COUNT) return;
+
+    stats_mark end = stats_now();
+    STATS_LOCK();
+    stats.wall[p] += end.wall - start.wall;
+    stats.cpu[p] += end.cpu - start.cpu;
+    STATS_UNLOCK();
+
+    stats_span(phase_names[p], 0, start, end);
+}
+
+/* ____________________________________________________________________________
+
+    void stats_count(counter c, unsigned long long n)
+
+    Adds to a counter
+
+    Parameters:
+        c - The counter
+        n - The amount to add
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void stats_count(counter c, unsigned long long n) {
+
+    // sanity check
+    if(c < 0 || c >= COUNTER_COUNT) return;
+
+    STATS_LOCK();
+    stats.counters[c] += n;
+    STATS_UNLOCK();
+}
+
+/* ____________________________________________________________________________
+
+    void stats_peak(counter c, unsigned long long n)
+
+    Raises a counter which keeps the largest value to a value
+
+    Parameters:
+        c - The counter
+        n - The value
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void stats_peak(counter c, unsigned long long n) {
+
+    // sanity check
+    if(c < 0 || c >= COUNTER_COUNT) return;
+
+    STATS_LOCK();
+    if(n > stats.counters[c]) stats.counters[c] = n;
+    STATS_UNLOCK();
+}
+
+/* ____________________________________________________________________________
+
+    void stats_print(FILE *out)
+
+    Prints a summary of the phases and counters
+
+    Parameters:
+        out - The output stream
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void stats_print(FILE *out) {
+
+    // sanity check
+    if(!out) return;
+
+    double wall = 0.0, cpu = 0.0;
+
+    fprintf(out, "Statistics:\n");
+    fprintf(out, "  %-16s %12s %12s\n", "phase", "wall [ms]", "cpu [ms]");
+    for(int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(out, "  %-16s %12.3f %12.3f\n", phase_names[i], stats.wall[i] * 1e3, stats.cpu[i] * 1e3);
+        wall += stats.wall[i];
+        cpu += stats.cpu[i];
+    }
+    fprintf(out, "  %-16s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+
+    for(int i = 0; i < COUNTER_COUNT; i++) {
+        fprintf(out, "  %-16s %12llu\n", counter_names[i], stats.counters[i]);
+    }
+}
+
+/* ____________________________________________________________________________
+
+    int stats_finish(void)
+
+    Writes the trace file in the Chrome trace event format and releases
+    the recorded spans
+
+    Parameters:
+        None
+
+    Returns:
+        1 on success or without a trace, 0 if the file cannot be written
+   ____________________________________________________________________________
+*/
+int stats_finish(void) {
+
+    int ok = 1;
+
+    if(stats.trace_file) {
+        FILE *f = fopen(stats.trace_file, "w");
+        ok = f != NULL;
+
+        if(f) {
+            fprintf(f, "{\"traceEvents\": [\n");
+            for(size_t i = 0; i < stats.count; i++) {
+                const trace_event *e = &stats.events[i];
+                fprintf(f, "  {\"name\": \"%s\", \"cat\": \"graph\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                           "\"ts\": %.3f, \"dur\": %.3f},\n",
+                        e->name, e->thread, e->start * 1e6, e->duration * 1e6);
+            }
+
+            // the counters at the end of the render
+            double end = (stats_now().wall - stats.origin.wall) * 1e6;
+            fprintf(f, "  {\"name\": \"counters\", \"cat\": \"graph\", \"ph\": \"C\", \"pid\": 1, \"tid\": 0, "
+                       "\"ts\": %.3f, \"args\": {", end);
+            for(int i = 0; i < COUNTER_COUNT; i++) {
+                fprintf(f, "%s\"%s\": %llu", i ? ", " : "", counter_names[i], stats.counters[i]);
+            }
+            fprintf(f, "}}\n], \"displayTimeUnit\": \"ms\"}\n");
+
+            ok = fclose(f) == 0;
+        }
+    }
+
+    free(stats.events);
+    stats.events = NULL;
+    stats.count = 0;
+    stats.capacity = 0;
+    stats.trace_file = NULL;
+
+    return ok;
+}
@@ -0,0 +1,72 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+/* ____________________________________________________________________________
+
+    Statistics and Tracing
+
+    Wall and CPU time of the phases of the pipeline and counters of the
+    render. The phases and counters are guarded by a lock, the renders of
+    a job file update them from several threads, spans of the sampling
+    threads are recorded after they are joined. With a trace file every
+    span is also written as a Chrome trace event.
+   ____________________________________________________________________________
+*/
+
+// phases of the pipeline
+typedef enum {
+    PHASE_PREPROCESS,
+    PHASE_VALIDATE,
+    PHASE_PARSE,
+    PHASE_COMPILE,
+    PHASE_SAMPLE,
+    PHASE_SIMPLIFY,
+    PHASE_EMIT,
+    PHASE_COUNT
+} phase;
+
+// counters of the render
+typedef enum {
+    COUNTER_EVALUATIONS,
+    COUNTER_NAN,
+    COUNTER_OUT_OF_RANGE,
+    COUNTER_PEN_UPS,
+    COUNTER_BYTES,
+    COUNTER_NODES_REMOVED,
+    COUNTER_CACHED_SAMPLES,
+    COUNTER_PRUNED_SAMPLES,
+    COUNTER_ARENA_PEAK,         // the most scratch bytes of a render
+    COUNTER_COUNT
+} counter;
+
+// point in time, wall clock and CPU time of the process in seconds
+typedef struct {
+    double wall;
+    double cpu;
+} stats_mark;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+void stats_start(const char *trace_file);
+
+stats_mark stats_now(void);
+
+void stats_phase(phase p, stats_mark start);
+
+void stats_span(const char *name, int thread, stats_mark start, stats_mark end);
+
+void stats_count(counter c, unsigned long long n);
+
+void stats_peak(counter c, unsigned long long n);
+
+void stats_print(FILE *out);
+
+int stats_finish(void);
+
+#endif //STATS_H
@@ -0,0 +1,543 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef _WIN32
+#define TILE_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "tilecache.h"
+
+// constants
+#define TILE_MAGIC "GVTILES1"
+#define TILE_TABLE_INITIAL 256
+#define TILE_PATH_SIZE 4096
+#define TILE_BYTES (sizeof(double) * TILE_SAMPLES)
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+// a signaling NaN marks a sample not evaluated yet, evaluations only
+// produce quiet NaNs
+#define TILE_MISSING 0x7ff4000000000001ULL
+
+// the beginning of the file, the key follows padded to 8 bytes
+typedef struct {
+    char magic[8];
+    uint64_t key_length;
+    uint64_t table;             // offset of the table of tiles
+    uint64_t capacity;          // slots of the table, a power of two
+    uint64_t tiles;             // number of tiles
+    uint64_t end;               // used bytes of the file
+} tile_header;
+
+// a slot of the open addressing table of tiles
+typedef struct {
+    int64_t index;              // index of the tile in its level
+    int32_t level;
+    uint32_t used;
+    uint64_t offset;            // offset of the samples in the file
+} tile_slot;
+
+#ifdef TILE_MMAP
+
+// the caches open in this process, a file is mapped once
+static tile_cache *open_caches = NULL;
+static pthread_mutex_t open_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ____________________________________________________________________________
+
+    static tile_header *header(tile_cache *c)
+
+    Returns the header of the mapped file
+
+    Parameters:
+        c - A pointer to the cache
+
+    Returns:
+        A pointer to the header
+   ____________________________________________________________________________
+*/
+static tile_header *header(tile_cache *c) {
+
+    return (tile_header *)c->base;
+}
+
+/* ____________________________________________________________________________
+
+    static int tile_map(tile_cache *c, size_t size)
+
+    Maps the file with the given size, the file is enlarged when needed
+
+    Parameters:
+        c - A pointer to the cache
+        size - The size to map
+
+    Returns:
+        1 on success, 0 if the file cannot be enlarged or mapped
+   ____________________________________________________________________________
+*/
+static int tile_map(tile_cache *c, size_t size) {
+
+    struct stat info;
+    if(fstat(c->fd, &info) != 0) return 0;
+    if((size_t)info.st_size < size && ftruncate(c->fd, (off_t)size) != 0) return 0;
+
+    if(c->base) munmap(c->base, c->size);
+    c->base = (unsigned char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    if(c->base == MAP_FAILED) {
+        c->base = NULL;
+        c->size = 0;
+        return 0;
+    }
+    c->size = size;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static int tile_reserve(tile_cache *c, size_t bytes, uint64_t *offset)
+
+    Reserves space at the end of the used part of the file, the file grows
+    by doubling so the mapping changes rarely
+
+    Parameters:
+        c - A pointer to the cache
+        bytes - The size of the space
+        offset - A pointer receiving the offset of the space
+
+    Returns:
+        1 on success, 0 if the file cannot grow
+   ____________________________________________________________________________
+*/
+static int tile_reserve(tile_cache *c, size_t bytes, uint64_t *offset) {
+
+    uint64_t end = header(c)->end;
+    if(end + bytes > c->size) {
+        size_t size = 2 * c->size;
+        if(size < end + bytes) size = end + bytes;
+        if(!tile_map(c, size)) return 0;
+    }
+
+    *offset = end;
+    header(c)->end = end + bytes;
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static tile_slot *find_slot(tile_cache *c, int level, int64_t tile)
+
+    Finds the slot of a tile in the table by linear probing
+
+    Parameters:
+        c - A pointer to the cache
+        level - The level of the tile
+        tile - The index of the tile
+
+    Returns:
+        The slot of the tile or the empty slot where it belongs
+   ____________________________________________________________________________
+*/
+static tile_slot *find_slot(tile_cache *c, int level, int64_t tile) {
+
+    tile_header *h = header(c);
+    tile_slot *table = (tile_slot *)(c->base + h->table);
+    uint64_t mask = h->capacity - 1;
+
+    uint64_t i = (((uint64_t)tile ^ ((uint64_t)(uint32_t)level << 40)) * HASH_MULTIPLIER) >> 20;
+    for(;; i++) {
+        tile_slot *s = &table[i & mask];
+        if(!s->used || (s->level == level && s->index == tile)) return s;
+    }
+}
+
+/* ____________________________________________________________________________
+
+    static int grow_table(tile_cache *c)
+
+    Moves the tiles into a table of twice the capacity at the end of the
+    file, the old table stays unused
+
+    Parameters:
+        c - A pointer to the cache
+
+    Returns:
+        1 on success, 0 if the file cannot grow
+   ____________________________________________________________________________
+*/
+static int grow_table(tile_cache *c) {
+
+    uint64_t capacity = 2 * header(c)->capacity;
+    uint64_t offset;
+    if(!tile_reserve(c, sizeof(tile_slot) * capacity, &offset)) return 0;
+
+    tile_header *h = header(c);
+    uint64_t old_table = h->table, old_capacity = h->capacity;
+    memset(c->base + offset, 0, sizeof(tile_slot) * capacity);
+    h->table = offset;
+    h->capacity = capacity;
+
+    for(uint64_t i = 0; i < old_capacity; i++) {
+        tile_slot *old = (tile_slot *)(c->base + old_table) + i;
+        if(old->used) *find_slot(c, old->level, old->index) = *old;
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static double *tile_samples(tile_cache *c, int level, int64_t tile, int create)
+
+    Finds the samples of a tile, a new tile has all samples missing
+
+    Parameters:
+        c - A pointer to the cache
+        level - The level of the tile
+        tile - The index of the tile
+        create - 1 to create a missing tile, 0 to only look it up
+
+    Returns:
+        A pointer to the samples of the tile, valid until the file grows,
+        or NULL if the tile is not present
+   ____________________________________________________________________________
+*/
+static double *tile_samples(tile_cache *c, int level, int64_t tile, int create) {
+
+    tile_slot *s = find_slot(c, level, tile);
+    if(s->used) return (double *)(c->base + s->offset);
+    if(!create) return NULL;
+
+    // keep the table at most half full
+    if(2 * (header(c)->tiles + 1) > header(c)->capacity) {
+        if(!grow_table(c)) return NULL;
+    }
+
+    uint64_t offset;
+    if(!tile_reserve(c, TILE_BYTES, &offset)) return NULL;
+
+    uint64_t missing = TILE_MISSING;
+    for(size_t i = 0; i < TILE_SAMPLES; i++) memcpy(c->base + offset + i * sizeof(double), &missing, sizeof(double));
+
+    // the mapping may have moved
+    s = find_slot(c, level, tile);
+    s->index = tile;
+    s->level = level;
+    s->used = 1;
+    s->offset = offset;
+    header(c)->tiles++;
+
+    return (double *)(c->base + offset);
+}
+
+/* ____________________________________________________________________________
+
+    static int tile_valid(tile_cache *c, const char *key, size_t key_length)
+
+    Checks the mapped file, its header, key and table
+
+    Parameters:
+        c - A pointer to the cache
+        key - The expected key
+        key_length - The length of the key
+
+    Returns:
+        1 if the file holds the tiles of the key, 0 otherwise
+   ____________________________________________________________________________
+*/
+static int tile_valid(tile_cache *c, const char *key, size_t key_length) {
+
+    if(c->size < sizeof(tile_header) + key_length) return 0;
+
+    tile_header *h = header(c);
+    if(memcmp(h->magic, TILE_MAGIC, sizeof(h->magic)) != 0 || h->key_length != key_length) return 0;
+    if(memcmp(c->base + sizeof(tile_header), key, key_length) != 0) return 0;
+    if(h->end > c->size || h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0) return 0;
+    if(h->table > h->end || h->capacity > (h->end - h->table) / sizeof(tile_slot)) return 0;
+
+    tile_slot *table = (tile_slot *)(c->base + h->table);
+    for(uint64_t i = 0; i < h->capacity; i++) {
+        if(table[i].used && (table[i].offset > h->end || h->end - table[i].offset < TILE_BYTES)) return 0;
+    }
+
+    return 1;
+}
+
+/* ____________________________________________________________________________
+
+    static int tile_initialize(tile_cache *c, const char *key, size_t key_length)
+
+    Replaces the content of the file by an empty cache of the key
+
+    Parameters:
+        c - A pointer to the cache
+        key - The key
+        key_length - The length of the key
+
+    Returns:
+        1 on success, 0 if the file cannot be written
+   ____________________________________________________________________________
+*/
+static int tile_initialize(tile_cache *c, const char *key, size_t key_length) {
+
+    size_t table = (sizeof(tile_header) + key_length + 7) & ~(size_t)7;
+    size_t end = table + sizeof(tile_slot) * TILE_TABLE_INITIAL;
+
+    if(c->base) munmap(c->base, c->size);
+    c->base = NULL;
+    if(ftruncate(c->fd, 0) != 0 || !tile_map(c, end + 16 * TILE_BYTES)) return 0;
+
+    tile_header *h = header(c);
+    memcpy(h->magic, TILE_MAGIC, sizeof(h->magic));
+    h->key_length = key_length;
+    h->table = table;
+    h->capacity = TILE_TABLE_INITIAL;
+    h->tiles = 0;
+    h->end = end;
+    memcpy(c->base + sizeof(tile_header), key, key_length);
+
+    return 1;
+}
+
+#endif // TILE_MMAP
+
+/* ____________________________________________________________________________
+
+    tile_cache *tile_cache_open(const char *directory, const char *key)
+
+    Opens the tile cache of an expression, the file is named by the hash
+    of the key inside the directory and created when it does not exist
+    or belongs to another key
+
+    Parameters:
+        directory - The directory of the cache files
+        key - The expression as normalized by format_tokens
+
+    Returns:
+        A pointer to the cache or NULL if the file cannot be mapped or is
+        locked by another process
+   ____________________________________________________________________________
+*/
+tile_cache *tile_cache_open(const char *directory, const char *key) {
+
+    // sanity check
+    if(!directory || !key) return NULL;
+
+#ifdef TILE_MMAP
+    unsigned long long hash = FNV_OFFSET;
+    for(const unsigned char *k = (const unsigned char *)key; *k; k++) hash = (hash ^ *k) * FNV_PRIME;
+
+    char path[TILE_PATH_SIZE];
+    if(snprintf(path, sizeof(path), "%s/tiles-%016llx.bin", directory, hash) >= (int)sizeof(path)) return NULL;
+
+    pthread_mutex_lock(&open_lock);
+
+    // share the mapping with the other renders of the process
+    tile_cache *c = open_caches;
+    while(c && strcmp(c->path, path) != 0) c = c->next;
+    if(c) {
+        c->references++;
+        pthread_mutex_unlock(&open_lock);
+        return c;
+    }
+
+    mkdir(directory, 0755);
+    c = (tile_cache *)calloc(1, sizeof(tile_cache));
+    if(c) c->path = (char *)malloc(strlen(path) + 1);
+    if(c) c->fd = c->path ? open(path, O_RDWR | O_CREAT, 0644) : -1;
+
+    // another process writing the same file would corrupt it
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    int ok = c && c->fd >= 0 && fcntl(c->fd, F_SETLK, &lock) == 0;
+
+    if(ok) {
+        struct stat info;
+        size_t length = strlen(key);
+        ok = fstat(c->fd, &info) == 0;
+        if(ok && info.st_size > 0) ok = tile_map(c, (size_t)info.st_size);
+        if(ok && !tile_valid(c, key, length)) ok = tile_initialize(c, key, length);
+    }
+
+    if(!ok) {
+        if(c && c->base) munmap(c->base, c->size);
+        if(c && c->fd >= 0) close(c->fd);
+        if(c) free(c->path);
+        free(c);
+        pthread_mutex_unlock(&open_lock);
+        return NULL;
+    }
+
+    strcpy(c->path, path);
+    pthread_mutex_init(&c->lock, NULL);
+    c->references = 1;
+    c->next = open_caches;
+    open_caches = c;
+
+    pthread_mutex_unlock(&open_lock);
+    return c;
+#else
+    return NULL;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    int tile_cache_lookup(tile_cache *c, int level, long long index, double *y)
+
+    Looks up the sample of a lattice point
+
+    Parameters:
+        c - A pointer to the cache
+        level - The level of the lattice, the point is x = index * 2^level
+        index - The index of the point
+        y - A pointer receiving the sample
+
+    Returns:
+        1 if the sample is cached, 0 otherwise
+   ____________________________________________________________________________
+*/
+int tile_cache_lookup(tile_cache *c, int level, long long index, double *y) {
+
+    // sanity check
+    if(!c || !y) return 0;
+
+#ifdef TILE_MMAP
+    int64_t tile = index >= 0 ? index / TILE_SAMPLES : -((-index + TILE_SAMPLES - 1) / TILE_SAMPLES);
+    int found = 0;
+
+    pthread_mutex_lock(&c->lock);
+    double *samples = tile_samples(c, level, tile, 0);
+    if(samples) {
+        uint64_t bits;
+        memcpy(&bits, &samples[index - tile * TILE_SAMPLES], sizeof(bits));
+        if(bits != TILE_MISSING) {
+            memcpy(y, &bits, sizeof(bits));
+            c->hits++;
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return found;
+#else
+    (void)level;
+    (void)index;
+    return 0;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    int tile_cache_store(tile_cache *c, int level, long long index, double y)
+
+    Stores the sample of a lattice point, its tile is created when needed
+
+    Parameters:
+        c - A pointer to the cache
+        level - The level of the lattice, the point is x = index * 2^level
+        index - The index of the point
+        y - The sample
+
+    Returns:
+        1 on success, 0 if the file cannot grow
+   ____________________________________________________________________________
+*/
+int tile_cache_store(tile_cache *c, int level, long long index, double y) {
+
+    // sanity check
+    if(!c) return 0;
+
+#ifdef TILE_MMAP
+    int64_t tile = index >= 0 ? index / TILE_SAMPLES : -((-index + TILE_SAMPLES - 1) / TILE_SAMPLES);
+
+    pthread_mutex_lock(&c->lock);
+    double *samples = tile_samples(c, level, tile, 1);
+    if(samples) samples[index - tile * TILE_SAMPLES] = y;
+    pthread_mutex_unlock(&c->lock);
+
+    return samples != NULL;
+#else
+    (void)level;
+    (void)index;
+    (void)y;
+    return 0;
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    unsigned long long tile_cache_hits(tile_cache *c)
+
+    Returns the number of samples found in the cache so far
+
+    Parameters:
+        c - A pointer to the cache
+
+    Returns:
+        The number of hits of all renders sharing the cache
+   ____________________________________________________________________________
+*/
+unsigned long long tile_cache_hits(tile_cache *c) {
+
+    // sanity check
+    if(!c) return 0;
+
+    unsigned long long hits;
+#ifdef TILE_MMAP
+    pthread_mutex_lock(&c->lock);
+    hits = c->hits;
+    pthread_mutex_unlock(&c->lock);
+#else
+    hits = c->hits;
+#endif
+
+    return hits;
+}
+
+/* ____________________________________________________________________________
+
+    void tile_cache_close(tile_cache **c)
+
+    Releases the cache of a render, the file is unmapped and unlocked when
+    no render of the process uses it anymore
+
+    Parameters:
+        c - A double pointer to the cache
+
+    Returns:
+        Nothing. The cache pointer is set to NULL
+   ____________________________________________________________________________
+*/
+void tile_cache_close(tile_cache **c) {
+
+    // sanity check
+    if(!c || !*c) return;
+
+#ifdef TILE_MMAP
+    pthread_mutex_lock(&open_lock);
+    if(--(*c)->references == 0) {
+        tile_cache **link = &open_caches;
+        while(*link != *c) link = &(*link)->next;
+        *link = (*c)->next;
+
+        munmap((*c)->base, (*c)->size);
+        close((*c)->fd);
+        pthread_mutex_destroy(&(*c)->lock);
+        free((*c)->path);
+        free(*c);
+    }
+    pthread_mutex_unlock(&open_lock);
+#endif
+
+    *c = NULL;
+}
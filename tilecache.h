@@ -0,0 +1,55 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stddef.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+// samples of one tile, the tile t of a level holds the points t * TILE_SAMPLES
+// up to (t + 1) * TILE_SAMPLES - 1 of the lattice of the level
+#define TILE_SAMPLES 256
+
+/* ____________________________________________________________________________
+
+    Tile Cache
+
+    Samples of a function persisted in a memory-mapped file, one file per
+    expression. The samples lie on dyadic lattices, the point k of the
+    level L is x = k * 2^L, so a level holds every point of the coarser
+    levels and the midpoints of its intervals are the points of the next
+    finer level. A file is shared by all renders of the process and locked
+    against other processes.
+   ____________________________________________________________________________
+*/
+
+typedef struct tile_cache {
+    char *path;
+    int fd;
+    unsigned char *base;        // the mapped file
+    size_t size;                // the mapped size
+    unsigned long long hits;    // samples found in the cache
+    int references;             // renders using the cache
+    struct tile_cache *next;    // the next open cache of the process
+#ifndef _WIN32
+    pthread_mutex_t lock;
+#endif
+} tile_cache;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+tile_cache *tile_cache_open(const char *directory, const char *key);
+
+int tile_cache_lookup(tile_cache *c, int level, long long index, double *y);
+
+int tile_cache_store(tile_cache *c, int level, long long index, double y);
+
+unsigned long long tile_cache_hits(tile_cache *c);
+
+void tile_cache_close(tile_cache **c);
+
+#endif //TILECACHE_H
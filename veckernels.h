@@ -0,0 +1,360 @@
+/* ____________________________________________________________________________
+
+    veckernels.h
+
+    Width independent bodies of the vectorized math kernels. The file is
+    included by vecmath.c once per instruction set, the including file
+    defines:
+
+        VD, VI, VU        - vectors of doubles, signed and unsigned 64-bit
+                            integers with VEC_WIDTH lanes
+        VEC_WIDTH         - number of lanes
+        VEC_NAME(name)    - name of the kernel for this instruction set
+        VEC_SQRT(v)       - square root of a vector
+        VEC_ALL(m)        - nonzero if all lanes of a mask are set
+
+    The reductions and polynomials follow fdlibm, the kernels only compute
+    lanes inside their fast domain, the other lanes are left to libm.
+   ____________________________________________________________________________
+*/
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(exp_kernel)(VD x, VD x_lo)
+
+    Computes exp(x + x_lo) for x in [-708, 709]
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(exp_kernel)(VD x, VD x_lo) {
+
+    // x = k * ln2 + r, |r| <= ln2 / 2
+    VD t = x * VM_LOG2E + VM_SHIFTER;
+    VD kd = t - VM_SHIFTER;
+    VI k = (VI)t - VM_SHIFTER_BITS;
+
+    VD hi = x - kd * VM_LN2_HI;
+    VD lo = kd * VM_LN2_LO - x_lo;
+    VD r = hi - lo;
+
+    // exp(r) by the rational approximation of fdlibm
+    VD z = r * r;
+    VD c = r - z * (VM_EXP_P1 + z * (VM_EXP_P2 + z * (VM_EXP_P3 + z * (VM_EXP_P4 + z * VM_EXP_P5))));
+    VD y = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+
+    // scale by 2^k directly in the exponent bits
+    return (VD)((VU)y + ((VU)k << 52));
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(log_reduce)(VD x, VD *kd, VD *f)
+
+    Splits a positive normal x into kd * ln2 + log(1 + f) with
+    1 + f in [sqrt(2)/2, sqrt(2))
+   ____________________________________________________________________________
+*/
+static void VEC_NAME(log_reduce)(VD x, VD *kd, VD *f) {
+
+    // biased exponent of x scaled to the interval around 1
+    VU bits = (VU)x;
+    VU e = (bits + VM_LOG_OFFSET) >> 52;
+
+    // 1 + f = x / 2^k
+    VU m = bits - ((e - 1023) << 52);
+    *f = (VD)m - 1.0;
+
+    // convert the exponent without an integer to double instruction
+    *kd = (VD)(e | VM_EXP_MAGIC) - (VM_TWO52 + 1023.0);
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(log_kernel)(VD x)
+
+    Computes the natural logarithm of a positive normal x
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(log_kernel)(VD x) {
+
+    VD kd, f;
+    VEC_NAME(log_reduce)(x, &kd, &f);
+
+    VD s = f / (2.0 + f);
+    VD z = s * s;
+    VD w = z * z;
+    VD t1 = w * (VM_LG2 + w * (VM_LG4 + w * VM_LG6));
+    VD t2 = z * (VM_LG1 + w * (VM_LG3 + w * (VM_LG5 + w * VM_LG7)));
+    VD hfsq = 0.5 * f * f;
+
+    return kd * VM_LN2_HI - ((hfsq - (s * (hfsq + t1 + t2) + kd * VM_LN2_LO)) - f);
+}
+
+/* ____________________________________________________________________________
+
+    static void VEC_NAME(two_product)(VD a, VD b, VD *p, VD *e)
+
+    Dekker's exact product a * b = p + e
+   ____________________________________________________________________________
+*/
+static void VEC_NAME(two_product)(VD a, VD b, VD *p, VD *e) {
+
+    VD ca = a * VM_SPLITTER;
+    VD a_hi = ca - (ca - a);
+    VD a_lo = a - a_hi;
+    VD cb = b * VM_SPLITTER;
+    VD b_hi = cb - (cb - b);
+    VD b_lo = b - b_hi;
+
+    *p = a * b;
+    *e = ((a_hi * b_hi - *p) + a_hi * b_lo + a_lo * b_hi) + a_lo * b_lo;
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(log_extended)(VD x, VD *lo)
+
+    Computes the natural logarithm of a positive normal x as an unevaluated
+    sum of two doubles, accurate enough to be multiplied by an exponent
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(log_extended)(VD x, VD *lo) {
+
+    VD kd, f;
+    VEC_NAME(log_reduce)(x, &kd, &f);
+
+    VD s = f / (2.0 + f);
+    VD z = s * s;
+    VD w = z * z;
+    VD t1 = w * (VM_LG2 + w * (VM_LG4 + w * VM_LG6));
+    VD t2 = z * (VM_LG1 + w * (VM_LG3 + w * (VM_LG5 + w * VM_LG7)));
+
+    // f * f / 2 exactly
+    VD sq, sq_lo;
+    VEC_NAME(two_product)(f, f, &sq, &sq_lo);
+    VD hfsq = 0.5 * sq;
+    VD hfsq_lo = 0.5 * sq_lo;
+
+    // k * ln2_hi + f - hfsq with the rounding errors kept aside
+    VD a = kd * VM_LN2_HI;
+    VD h1 = a + f;
+    VD v1 = h1 - a;
+    VD e1 = (a - (h1 - v1)) + (f - v1);
+    VD h2 = h1 - hfsq;
+    VD v2 = h2 - h1;
+    VD e2 = (h1 - (h2 - v2)) - (hfsq + v2);
+
+    VD tail = e1 + e2 - hfsq_lo + s * (hfsq + t1 + t2) + kd * VM_LN2_LO;
+    VD hi = h2 + tail;
+    *lo = tail - (hi - h2);
+
+    return hi;
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(sincos_reduce)(VD x, VI *q)
+
+    Reduces x to r in [-pi/4, pi/4] with x = q * pi/2 + r
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(sincos_reduce)(VD x, VI *q) {
+
+    VD t = x * VM_TWO_OVER_PI + VM_SHIFTER;
+    VD kd = t - VM_SHIFTER;
+    *q = (VI)t - VM_SHIFTER_BITS;
+
+    // Cody-Waite reduction with pi/2 split into three parts
+    return ((x - kd * VM_PIO2_1) - kd * VM_PIO2_2) - kd * VM_PIO2_3;
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(sin_poly)(VD r) and VEC_NAME(cos_poly)(VD r)
+
+    Sine and cosine on [-pi/4, pi/4]
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(sin_poly)(VD r) {
+
+    VD z = r * r;
+    VD v = z * r;
+    VD p = VM_S2 + z * (VM_S3 + z * (VM_S4 + z * (VM_S5 + z * VM_S6)));
+
+    return r + v * (VM_S1 + z * p);
+}
+
+static VD VEC_NAME(cos_poly)(VD r) {
+
+    VD z = r * r;
+    VD p = z * (VM_C1 + z * (VM_C2 + z * (VM_C3 + z * (VM_C4 + z * (VM_C5 + z * VM_C6)))));
+    VD hz = 0.5 * z;
+    VD w = 1.0 - hz;
+
+    return w + (((1.0 - w) - hz) + z * p);
+}
+
+/* ____________________________________________________________________________
+
+    static VD VEC_NAME(select)(VI mask, VD a, VD b)
+
+    Takes lanes of a where the mask is set and lanes of b elsewhere
+   ____________________________________________________________________________
+*/
+static VD VEC_NAME(select)(VI mask, VD a, VD b) {
+
+    return (VD)((mask & (VI)a) | (~mask & (VI)b));
+}
+
+/* ____________________________________________________________________________
+
+    Kernels applied to arrays
+
+    Every kernel processes VEC_WIDTH values at once. When a lane falls out
+    of the fast domain the whole vector is fixed lane by lane with libm,
+    the remaining tail of the array is evaluated by libm as well.
+   ____________________________________________________________________________
+*/
+#define VEC_UNARY_LOOP(values, n, domain, kernel, scalar)                   \
+    do {                                                                    \
+        size_t i = 0;                                                       \
+        for(; i + VEC_WIDTH <= (n); i += VEC_WIDTH) {                       \
+            VD x;                                                           \
+            memcpy(&x, (values) + i, sizeof(VD));                           \
+            VD y = kernel;                                                  \
+            if(!VEC_ALL(domain)) {                                          \
+                for(int j = 0; j < VEC_WIDTH; j++) y[j] = scalar(x[j]);     \
+            }                                                               \
+            memcpy((values) + i, &y, sizeof(VD));                           \
+        }                                                                   \
+        for(; i < (n); i++) (values)[i] = scalar((values)[i]);              \
+    } while(0)
+
+static void VEC_NAME(sqrt)(double *values, size_t n) {
+
+    size_t i = 0;
+    for(; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VD x;
+        memcpy(&x, values + i, sizeof(VD));
+        x = VEC_SQRT(x);
+        memcpy(values + i, &x, sizeof(VD));
+    }
+    for(; i < n; i++) values[i] = sqrt(values[i]);
+}
+
+static void VEC_NAME(exp)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= -708.0) & (VI)(x <= 709.0),
+                   VEC_NAME(exp_kernel)(x, x - x),
+                   exp);
+}
+
+static void VEC_NAME(log)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= VM_DBL_MIN) & (VI)(x <= VM_DBL_MAX),
+                   VEC_NAME(log_kernel)(x),
+                   log);
+}
+
+static void VEC_NAME(log10)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= VM_DBL_MIN) & (VI)(x <= VM_DBL_MAX),
+                   VEC_NAME(log_kernel)(x) * VM_INV_LN10,
+                   log10);
+}
+
+static VD VEC_NAME(sin_kernel)(VD x) {
+
+    VI q;
+    VD r = VEC_NAME(sincos_reduce)(x, &q);
+    VD y = VEC_NAME(select)((VI)((q & 1) == 0), VEC_NAME(sin_poly)(r), VEC_NAME(cos_poly)(r));
+
+    // negate in the lower half plane
+    return (VD)((VU)y ^ ((VU)(q & 2) << 62));
+}
+
+static VD VEC_NAME(cos_kernel)(VD x) {
+
+    VI q;
+    VD r = VEC_NAME(sincos_reduce)(x, &q);
+    VD y = VEC_NAME(select)((VI)((q & 1) == 0), VEC_NAME(cos_poly)(r), VEC_NAME(sin_poly)(r));
+
+    // negate in the left half plane
+    return (VD)((VU)y ^ ((VU)((q + 1) & 2) << 62));
+}
+
+static VD VEC_NAME(tan_kernel)(VD x) {
+
+    VI q;
+    VD r = VEC_NAME(sincos_reduce)(x, &q);
+    VD s = VEC_NAME(sin_poly)(r);
+    VD c = VEC_NAME(cos_poly)(r);
+
+    return VEC_NAME(select)((VI)((q & 1) == 0), s / c, -c / s);
+}
+
+static void VEC_NAME(sin)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= -VM_TRIG_LIMIT) & (VI)(x <= VM_TRIG_LIMIT),
+                   VEC_NAME(sin_kernel)(x),
+                   sin);
+}
+
+static void VEC_NAME(cos)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= -VM_TRIG_LIMIT) & (VI)(x <= VM_TRIG_LIMIT),
+                   VEC_NAME(cos_kernel)(x),
+                   cos);
+}
+
+static void VEC_NAME(tan)(double *values, size_t n) {
+
+    VEC_UNARY_LOOP(values, n,
+                   (VI)(x >= -VM_TRIG_LIMIT) & (VI)(x <= VM_TRIG_LIMIT),
+                   VEC_NAME(tan_kernel)(x),
+                   tan);
+}
+
+static void VEC_NAME(pow)(double *bases, const double *exponents, size_t n) {
+
+    size_t i = 0;
+    for(; i + VEC_WIDTH <= n; i += VEC_WIDTH) {
+        VD a, b;
+        memcpy(&a, bases + i, sizeof(VD));
+        memcpy(&b, exponents + i, sizeof(VD));
+
+        // |a|^b = exp(b * ln|a|) with the logarithm in extended precision
+        VD abs_a = (VD)((VI)a & VM_ABS_MASK);
+        VD l_lo;
+        VD l = VEC_NAME(log_extended)(abs_a, &l_lo);
+        VD y, y_lo;
+        VEC_NAME(two_product)(b, l, &y, &y_lo);
+        y_lo = y_lo + b * l_lo;
+        VD result = VEC_NAME(exp_kernel)(y, y_lo);
+
+        // negative bases need an integer exponent, odd ones flip the sign
+        VD t = b + VM_SHIFTER;
+        VI integer = (VI)((t - VM_SHIFTER) == b);
+        VI odd = (VI)(((VU)t & 1) << 63);
+        result = (VD)((VI)result ^ (odd & (VI)(a < 0.0)));
+
+        VI domain = (VI)(abs_a >= VM_DBL_MIN) & (VI)(abs_a <= VM_DBL_MAX) &
+                    (VI)(b >= -VM_POW_EXPONENT_LIMIT) & (VI)(b <= VM_POW_EXPONENT_LIMIT) &
+                    (VI)(y >= -VM_POW_LIMIT) & (VI)(y <= VM_POW_LIMIT) &
+                    ((VI)(a > 0.0) | integer);
+        if(!VEC_ALL(domain)) {
+            for(int j = 0; j < VEC_WIDTH; j++) {
+                if(!domain[j]) result[j] = pow(a[j], b[j]);
+            }
+        }
+
+        memcpy(bases + i, &result, sizeof(VD));
+    }
+    for(; i < n; i++) bases[i] = pow(bases[i], exponents[i]);
+}
+
+#undef VEC_UNARY_LOOP
@@ -0,0 +1,352 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "vecmath.h"
+
+// the vector kernels need GCC vector extensions on x86
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECMATH_X86 1
+#include <immintrin.h>
+#endif
+
+/* ____________________________________________________________________________
+
+    Constants of the kernels
+   ____________________________________________________________________________
+*/
+#define VM_SHIFTER 6755399441055744.0                   // 1.5 * 2^52
+#define VM_SHIFTER_BITS 0x4338000000000000LL
+#define VM_TWO52 4503599627370496.0
+#define VM_EXP_MAGIC 0x4330000000000000ULL
+#define VM_LOG_OFFSET 0x00095f619980c433ULL             // 1.0 - sqrt(2)/2 in bits
+#define VM_ABS_MASK 0x7fffffffffffffffLL
+#define VM_SPLITTER 134217729.0                         // 2^27 + 1
+#define VM_DBL_MIN 2.2250738585072014e-308
+#define VM_DBL_MAX 1.7976931348623157e+308
+
+#define VM_LOG2E 1.44269504088896338700e+00
+#define VM_LN2_HI 6.93147180369123816490e-01
+#define VM_LN2_LO 1.90821492927058770002e-10
+#define VM_INV_LN10 4.34294481903251827651e-01
+
+#define VM_EXP_P1 1.66666666666666019037e-01
+#define VM_EXP_P2 -2.77777777770155933842e-03
+#define VM_EXP_P3 6.61375632143793436117e-05
+#define VM_EXP_P4 -1.65339022054652515390e-06
+#define VM_EXP_P5 4.13813679705723846039e-08
+
+#define VM_LG1 6.666666666666735130e-01
+#define VM_LG2 3.999999999940941908e-01
+#define VM_LG3 2.857142874366239149e-01
+#define VM_LG4 2.222219843214978396e-01
+#define VM_LG5 1.818357216161805012e-01
+#define VM_LG6 1.531383769920937332e-01
+#define VM_LG7 1.479819860511658591e-01
+
+#define VM_TWO_OVER_PI 6.36619772367581382433e-01
+#define VM_PIO2_1 1.57079632673412561417e+00
+#define VM_PIO2_2 6.07710050630396597660e-11
+#define VM_PIO2_3 2.02226624871116645580e-21
+#define VM_TRIG_LIMIT 1e5
+
+#define VM_S1 -1.66666666666666324348e-01
+#define VM_S2 8.33333333332248946124e-03
+#define VM_S3 -1.98412698298579493134e-04
+#define VM_S4 2.75573137070700676789e-06
+#define VM_S5 -2.50507602534068634195e-08
+#define VM_S6 1.58969099521155010221e-10
+
+#define VM_C1 4.16666666666666019037e-02
+#define VM_C2 -1.38888888888741095749e-03
+#define VM_C3 2.48015872894767294178e-05
+#define VM_C4 -2.75573143513906633035e-07
+#define VM_C5 2.08757232129817482790e-09
+#define VM_C6 -1.13596475577881948265e-11
+
+#define VM_POW_LIMIT 32.0
+#define VM_POW_EXPONENT_LIMIT 2147483648.0
+
+#ifdef VECMATH_X86
+
+/* ____________________________________________________________________________
+
+    SSE2 kernels, two doubles per vector
+   ____________________________________________________________________________
+*/
+#pragma GCC push_options
+#pragma GCC target("sse2")
+
+typedef double vd2 __attribute__((vector_size(16)));
+typedef long long vi2 __attribute__((vector_size(16)));
+typedef unsigned long long vu2 __attribute__((vector_size(16)));
+
+#define VD vd2
+#define VI vi2
+#define VU vu2
+#define VEC_WIDTH 2
+#define VEC_NAME(name) sse2_##name
+#define VEC_SQRT(v) ((vd2)_mm_sqrt_pd((__m128d)(v)))
+#define VEC_ALL(m) (_mm_movemask_pd((__m128d)(m)) == 0x3)
+#include "veckernels.h"
+#undef VD
+#undef VI
+#undef VU
+#undef VEC_WIDTH
+#undef VEC_NAME
+#undef VEC_SQRT
+#undef VEC_ALL
+
+#pragma GCC pop_options
+
+/* ____________________________________________________________________________
+
+    AVX2 kernels, four doubles per vector
+   ____________________________________________________________________________
+*/
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+typedef double vd4 __attribute__((vector_size(32)));
+typedef long long vi4 __attribute__((vector_size(32)));
+typedef unsigned long long vu4 __attribute__((vector_size(32)));
+
+#define VD vd4
+#define VI vi4
+#define VU vu4
+#define VEC_WIDTH 4
+#define VEC_NAME(name) avx2_##name
+#define VEC_SQRT(v) ((vd4)_mm256_sqrt_pd((__m256d)(v)))
+#define VEC_ALL(m) (_mm256_movemask_pd((__m256d)(m)) == 0xf)
+#include "veckernels.h"
+#undef VD
+#undef VI
+#undef VU
+#undef VEC_WIDTH
+#undef VEC_NAME
+#undef VEC_SQRT
+#undef VEC_ALL
+
+#pragma GCC pop_options
+
+#endif // VECMATH_X86
+
+// the best implementation of the processor, detected once by the first
+// thread using the kernels, the build without threads only needs a flag
+#ifndef _WIN32
+static pthread_once_t detection = PTHREAD_ONCE_INIT;
+#else
+static int detected = 0;
+#endif
+static vecmath_level supported_level = VECMATH_SCALAR;
+
+// implementation forced by vecmath_set_level, -1 for the supported one
+static int forced_level = -1;
+
+/* ____________________________________________________________________________
+
+    static void detect_level(void)
+
+    Detects the best implementation from the CPUID of the processor, it
+    runs once by detect_once
+
+    Parameters:
+        None
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void detect_level(void) {
+
+    supported_level = VECMATH_SCALAR;
+#ifdef VECMATH_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        supported_level = VECMATH_AVX2;
+    } else if(__builtin_cpu_supports("sse2")) {
+        supported_level = VECMATH_SSE2;
+    }
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    static void detect_once(void)
+
+    Detects the best implementation on the first call, the later calls and
+    the concurrent ones wait for the first detection
+
+    Parameters:
+        None
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+static void detect_once(void) {
+
+#ifndef _WIN32
+    pthread_once(&detection, detect_level);
+#else
+    if(!detected) {
+        detect_level();
+        detected = 1;
+    }
+#endif
+}
+
+/* ____________________________________________________________________________
+
+    vecmath_level vecmath_get_level(void)
+
+    Returns the implementation used by the kernels, the processor is
+    detected on the first call of any thread
+
+    Parameters:
+        None
+
+    Returns:
+        The active vecmath_level
+   ____________________________________________________________________________
+*/
+vecmath_level vecmath_get_level(void) {
+
+    detect_once();
+
+    return forced_level >= 0 ? (vecmath_level)forced_level : supported_level;
+}
+
+/* ____________________________________________________________________________
+
+    void vecmath_set_level(vecmath_level level)
+
+    Forces an implementation of the kernels, levels the processor does not
+    support are lowered to the best supported one. It is called before any
+    thread using the kernels starts.
+
+    Parameters:
+        level - The requested vecmath_level
+
+    Returns:
+        Nothing.
+   ____________________________________________________________________________
+*/
+void vecmath_set_level(vecmath_level level) {
+
+    // detect the supported level first
+    detect_once();
+
+    forced_level = level < supported_level ? (int)level : (int)supported_level;
+}
+
+/* ____________________________________________________________________________
+
+    const char *vecmath_level_name(vecmath_level level)
+
+    Returns a readable name of the implementation
+
+    Parameters:
+        level - The vecmath_level
+
+    Returns:
+        The name of the level
+   ____________________________________________________________________________
+*/
+const char *vecmath_level_name(vecmath_level level) {
+
+    switch(level) {
+        case VECMATH_SSE2: return "sse2";
+        case VECMATH_AVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+/* ____________________________________________________________________________
+
+    Dispatch of the kernels
+
+    Each kernel evaluates the function over the array in place with the
+    active implementation, the scalar fallback calls libm.
+   ____________________________________________________________________________
+*/
+#ifdef VECMATH_X86
+#define VECMATH_DISPATCH(name, values, n, scalar)                           \
+    do {                                                                    \
+        if(!(values)) return;                                               \
+        switch(vecmath_get_level()) {                                       \
+            case VECMATH_AVX2: avx2_##name((values), (n)); return;          \
+            case VECMATH_SSE2: sse2_##name((values), (n)); return;          \
+            default: break;                                                 \
+        }                                                                   \
+        for(size_t i = 0; i < (n); i++) (values)[i] = scalar((values)[i]);  \
+    } while(0)
+#else
+#define VECMATH_DISPATCH(name, values, n, scalar)                           \
+    do {                                                                    \
+        if(!(values)) return;                                               \
+        for(size_t i = 0; i < (n); i++) (values)[i] = scalar((values)[i]);  \
+    } while(0)
+#endif
+
+void vec_sqrt(double *values, size_t n) {
+    VECMATH_DISPATCH(sqrt, values, n, sqrt);
+}
+
+void vec_exp(double *values, size_t n) {
+    VECMATH_DISPATCH(exp, values, n, exp);
+}
+
+void vec_log(double *values, size_t n) {
+    VECMATH_DISPATCH(log, values, n, log);
+}
+
+void vec_log10(double *values, size_t n) {
+    VECMATH_DISPATCH(log10, values, n, log10);
+}
+
+void vec_sin(double *values, size_t n) {
+    VECMATH_DISPATCH(sin, values, n, sin);
+}
+
+void vec_cos(double *values, size_t n) {
+    VECMATH_DISPATCH(cos, values, n, cos);
+}
+
+void vec_tan(double *values, size_t n) {
+    VECMATH_DISPATCH(tan, values, n, tan);
+}
+
+/* ____________________________________________________________________________
+
+    void vec_pow(double *bases, const double *exponents, size_t n)
+
+    Raises every base to the matching exponent in place
+
+    Parameters:
+        bases - The bases, overwritten by the results
+        exponents - The exponents
+        n - The number of values
+
+    Returns:
+        Nothing. The results are stored in the bases array
+   ____________________________________________________________________________
+*/
+void vec_pow(double *bases, const double *exponents, size_t n) {
+
+    // sanity check
+    if(!bases || !exponents) return;
+
+#ifdef VECMATH_X86
+    switch(vecmath_get_level()) {
+        case VECMATH_AVX2: avx2_pow(bases, exponents, n); return;
+        case VECMATH_SSE2: sse2_pow(bases, exponents, n); return;
+        default: break;
+    }
+#endif
+
+    for(size_t i = 0; i < n; i++) bases[i] = pow(bases[i], exponents[i]);
+}
@@ -0,0 +1,63 @@
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <stddef.h>
+
+/* ____________________________________________________________________________
+
+    Vectorized Math Kernels
+
+    The kernels evaluate a function over a whole array in place. The
+    implementation is chosen at runtime by CPUID, lanes outside of the
+    fast domain of a kernel (NaN, infinities, huge arguments, ...) are
+    recomputed by the C library, so the results only differ from libm
+    by the rounding error of the kernels. The bounds below are the largest
+    distances to the glibc results measured on random arguments:
+
+        sqrt             correctly rounded
+        exp              <= 1 ULP     for x in [-708, 709]
+        log              <= 1 ULP     for positive normal x
+        log10            <= 2 ULP     for positive normal x
+        sin, cos         <= 2 ULP     for |x| <= 1e5 (1 ULP for |x| <= 10)
+        tan              <= 4 ULP     for |x| <= 1e5
+        pow              <= 3 ULP     for |b * ln|a|| <= 32, |b| < 2^31
+
+    Arguments outside of these ranges are evaluated by libm.
+   ____________________________________________________________________________
+*/
+
+typedef enum {
+    VECMATH_SCALAR,
+    VECMATH_SSE2,
+    VECMATH_AVX2
+} vecmath_level;
+
+/* ____________________________________________________________________________
+
+    Function Prototypes
+   ____________________________________________________________________________
+*/
+
+vecmath_level vecmath_get_level(void);
+
+void vecmath_set_level(vecmath_level level);
+
+const char *vecmath_level_name(vecmath_level level);
+
+void vec_sqrt(double *values, size_t n);
+
+void vec_exp(double *values, size_t n);
+
+void vec_log(double *values, size_t n);
+
+void vec_log10(double *values, size_t n);
+
+void vec_sin(double *values, size_t n);
+
+void vec_cos(double *values, size_t n);
+
+void vec_tan(double *values, size_t n);
+
+void vec_pow(double *bases, const double *exponents, size_t n);
+
+#endif //VECMATH_H